@@ -7,6 +7,7 @@
 // information.
 //
 
+#include "config.h"
 #include <cups/backend.h>
 #include <string.h>
 #include <errno.h>
@@ -16,6 +17,253 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <pwd.h>
+#ifdef HAVE_ZSTD
+#  include <sys/file.h>
+#  include <time.h>
+#  include <zstd.h>
+#endif // HAVE_ZSTD
+
+
+#ifdef HAVE_ZSTD
+#  define ARCHIVE_LEVEL 19		// zstd compression level of the pack
+#  define ARCHIVE_MAGIC 0x184D2A50	// zstd skippable frame magic number
+
+
+//
+// Pack file being appended to
+//
+
+typedef struct archive_s
+{
+  int		fd;			// Pack file
+  off_t		pos;			// Current end of the pack
+  ZSTD_CCtx	*cctx;			// Compression context
+  char		*outbuf;		// Compressed data
+  size_t	outsize;		// Size of outbuf
+} archive_t;
+
+
+//
+// 'archive_compress()' - Compress data into the pack, ending the frame when
+//                        asked.
+//
+
+static int
+archive_compress(archive_t *ar,
+		 const void *data,
+		 size_t len,
+		 ZSTD_EndDirective mode)
+{
+  ZSTD_inBuffer in = { data, len, 0 };
+  ZSTD_outBuffer out;
+  size_t remaining;
+  ssize_t sizeout;
+  size_t done;
+
+  do
+  {
+    out.dst = ar->outbuf;
+    out.size = ar->outsize;
+    out.pos = 0;
+
+    remaining = ZSTD_compressStream2(ar->cctx, &out, &in, mode);
+    if (ZSTD_isError(remaining))
+    {
+      fprintf(stderr, "ERROR: while compressing: %s\n",
+	      ZSTD_getErrorName(remaining));
+      return (-1);
+    }
+
+    for (done = 0; done < out.pos; done += sizeout)
+    {
+      sizeout = write(ar->fd, ar->outbuf + done, out.pos - done);
+      if (sizeout < 0)
+	return (-1);
+    }
+    ar->pos += out.pos;
+  }
+  while (mode == ZSTD_e_end ? remaining > 0 : in.pos < in.size);
+
+  return (0);
+}
+
+
+//
+// 'archive()' - Append the job to the pack file of the user.
+//
+// Every page, up to and including its form feed, is compressed as a zstd
+// frame of its own, after a skippable frame with the job ID, user and title,
+// so that "zstd -d" decompresses the whole pack.  The line added to the index
+// for the job lists the offsets of its page frames and the end of the last
+// one: a single page is extracted without decompressing the rest with
+//
+//   tail -c +$((START + 1)) archive.brf.zst | head -c $((END - START)) | zstd -d
+//
+
+static int
+archive(const char *dir,
+	const char *jobid,
+	const char *user,
+	char *title)
+{
+  char *packfile;
+  char *indexfile;
+  char *header;
+  char *c;
+  char buffer[4096];
+  unsigned char frame[8];
+  char *ptr, *end, *ff;
+  ssize_t sizein;
+  int headerlen;
+  off_t start;
+  off_t *pages = NULL, *newpages;
+  size_t num_pages = 0, alloc_pages = 0, i;
+  int in_page = 0;
+  archive_t ar;
+  FILE *index;
+
+  // Index fields are separated by tabs
+  for (c = title; *c; c++)
+  {
+    if (*c == '\t' || *c == '\n' || *c == '\r')
+      *c = ' ';
+  }
+
+  if (asprintf(&packfile, "%s/archive.brf.zst", dir) < 0 ||
+      asprintf(&indexfile, "%s/archive.idx", dir) < 0 ||
+      (headerlen = asprintf(&header, "%s\t%s\t%s\n", jobid, user, title)) < 0)
+  {
+    fprintf(stderr, "ERROR: could not allocate memory\n");
+    return (CUPS_BACKEND_FAILED);
+  }
+
+  ar.outsize = ZSTD_CStreamOutSize();
+  if ((ar.outbuf = malloc(ar.outsize)) == NULL ||
+      (ar.cctx = ZSTD_createCCtx()) == NULL)
+  {
+    fprintf(stderr, "ERROR: could not allocate memory\n");
+    return (CUPS_BACKEND_FAILED);
+  }
+  ZSTD_CCtx_setParameter(ar.cctx, ZSTD_c_compressionLevel, ARCHIVE_LEVEL);
+  ZSTD_CCtx_setParameter(ar.cctx, ZSTD_c_checksumFlag, 1);
+
+  // Jobs are appended one at a time, the index line under the same lock
+  fprintf(stderr, "DEBUG: appending to \"%s\"\n", packfile);
+  ar.fd = open(packfile, O_WRONLY | O_CREAT | O_APPEND, 0600);
+  if (ar.fd < 0 || flock(ar.fd, LOCK_EX))
+  {
+    fprintf(stderr, "ERROR: could not open \"%s\": %s\n",
+	    packfile, strerror(errno));
+    return (CUPS_BACKEND_FAILED);
+  }
+  start = ar.pos = lseek(ar.fd, 0, SEEK_END);
+
+  // Job information
+  frame[0] = ARCHIVE_MAGIC & 255;
+  frame[1] = (ARCHIVE_MAGIC >> 8) & 255;
+  frame[2] = (ARCHIVE_MAGIC >> 16) & 255;
+  frame[3] = (ARCHIVE_MAGIC >> 24) & 255;
+  frame[4] = headerlen & 255;
+  frame[5] = (headerlen >> 8) & 255;
+  frame[6] = (headerlen >> 16) & 255;
+  frame[7] = (headerlen >> 24) & 255;
+  if (write(ar.fd, frame, sizeof(frame)) != sizeof(frame) ||
+      write(ar.fd, header, headerlen) != headerlen)
+    goto write_error;
+  ar.pos += sizeof(frame) + headerlen;
+
+  // Pages
+  while (1)
+  {
+    sizein = read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (sizein < 0)
+    {
+      fprintf(stderr, "ERROR: while reading input: %s\n", strerror(errno));
+      goto error;
+    }
+    if (sizein == 0)
+      break;
+
+    for (ptr = buffer, end = buffer + sizein; ptr < end; ptr = ff)
+    {
+      if (!in_page)
+      {
+	// Start of a page frame, also its end offset for the index
+	if (num_pages + 2 > alloc_pages)
+	{
+	  alloc_pages += 256;
+	  newpages = realloc(pages, alloc_pages * sizeof(off_t));
+	  if (newpages == NULL)
+	  {
+	    fprintf(stderr, "ERROR: could not allocate memory\n");
+	    goto error;
+	  }
+	  pages = newpages;
+	}
+	pages[num_pages++] = ar.pos;
+	in_page = 1;
+      }
+
+      if ((ff = memchr(ptr, '\f', end - ptr)) != NULL)
+	ff++;
+      else
+	ff = end;
+
+      if (archive_compress(&ar, ptr, ff - ptr,
+			   ff[-1] == '\f' ? ZSTD_e_end : ZSTD_e_continue))
+	goto write_error;
+
+      if (ff[-1] == '\f')
+	in_page = 0;
+    }
+  }
+
+  if (in_page && archive_compress(&ar, NULL, 0, ZSTD_e_end))
+    goto write_error;
+
+  // Index line: job ID, user, time, title, page offsets and end
+  if ((index = fopen(indexfile, "a")) == NULL)
+  {
+    fprintf(stderr, "ERROR: could not open \"%s\": %s\n",
+	    indexfile, strerror(errno));
+    goto error;
+  }
+  fprintf(index, "%s\t%s\t%ld\t%s\t", jobid, user, (long)time(NULL), title);
+  for (i = 0; i < num_pages; i++)
+    fprintf(index, "%lld ", (long long)pages[i]);
+  fprintf(index, "%lld\n", (long long)ar.pos);
+  if (fclose(index))
+  {
+    fprintf(stderr, "ERROR: while writing to \"%s\": %s\n",
+	    indexfile, strerror(errno));
+    goto error;
+  }
+
+  fprintf(stderr, "DEBUG: archived %lu pages, %lld bytes\n",
+	  (unsigned long)num_pages, (long long)(ar.pos - start));
+
+  if (close(ar.fd) < 0)
+  {
+    fprintf(stderr, "ERROR: while closing \"%s\": %s\n",
+	    packfile, strerror(errno));
+    return (CUPS_BACKEND_FAILED);
+  }
+
+  return (CUPS_BACKEND_OK);
+
+write_error:
+  fprintf(stderr, "ERROR: while writing to \"%s\": %s\n",
+	  packfile, strerror(errno));
+
+error:
+  // Do not leave a partial job in the pack
+  if (ftruncate(ar.fd, start))
+    fprintf(stderr, "ERROR: could not truncate \"%s\": %s\n",
+	    packfile, strerror(errno));
+  close(ar.fd);
+  return (CUPS_BACKEND_FAILED);
+}
+#endif // HAVE_ZSTD
 
 
 int
@@ -32,6 +280,8 @@ main(int argc,
   struct passwd *pw;
   int ret;
   int fd;
+  const char *uri = getenv("DEVICE_URI");
+  int archive_mode = 0;
 
   if (setuid(0))
   {
@@ -65,6 +315,16 @@ main(int argc,
     }
   }
 
+  // "cups-brf:/?archive" appends the jobs to a compressed pack file
+  if (uri && (c = strchr(uri, '?')) != NULL && !strcmp(c + 1, "archive"))
+  {
+#ifdef HAVE_ZSTD
+    archive_mode = 1;
+#else
+    fprintf(stderr, "WARNING: cups-brf built without zstd, archive mode is not available\n");
+#endif // HAVE_ZSTD
+  }
+
   // Now we have everything, turn into the user
   user = argv[2];
   pw = getpwnam(user);
@@ -117,6 +377,13 @@ main(int argc,
   if (!*title)
     title = "unknown";
 
+#ifdef HAVE_ZSTD
+  if (archive_mode)
+    return (archive(dir, argv[1], user, title));
+#else
+  (void)archive_mode;
+#endif // HAVE_ZSTD
+
   // generate mask
   if (asprintf(&outfile, "%s/%s.XXXXXX.brf", dir, title) < 0)
   {
@@ -0,0 +1,52 @@
+#!/bin/bash
+
+#
+# Copyright (c) 2022 Chandresh Soni
+#
+# Licensed under Apache License v2.0.  See the file "LICENSE" for more
+# information.
+#
+
+# Compare two result files written by run-bench.sh.
+#
+# Usage: compare.sh old-results.json new-results.json
+#
+# Prints the p50 latency and throughput of every benchmark present in both
+# files, with the new/old latency ratio (below 1.00 is faster).
+
+if [ $# != 2 ]; then
+  echo "Usage: $0 old-results.json new-results.json" >&2
+  exit 1
+fi
+
+awk '
+  # Extract a field from one of our flat JSON objects
+  function field(line, name,    v) {
+    if (!match(line, "\"" name "\":(\"[^\"]*\"|[^,}]*)"))
+      return ""
+    v = substr(line, RSTART + length(name) + 3, RLENGTH - length(name) - 3)
+    gsub(/"/, "", v)
+    return v
+  }
+
+  /"type":"bench"/ {
+    name = field($0, "name")
+    if (FILENAME == ARGV[1]) {
+      old_p50[name] = field($0, "p50_ms")
+      old_mbs[name] = field($0, "mb_per_sec")
+    } else if (name in old_p50) {
+      order[++ n] = name
+      new_p50[name] = field($0, "p50_ms")
+      new_mbs[name] = field($0, "mb_per_sec")
+      new_status[name] = field($0, "status")
+    }
+  }
+
+  END {
+    printf "%-40s %10s %10s %6s %10s %10s\n", "benchmark", "old p50ms", "new p50ms", "ratio", "old MB/s", "new MB/s"
+    for (i = 1; i <= n; i ++) {
+      name = order[i]
+      ratio = old_p50[name] > 0 ? new_p50[name] / old_p50[name] : 0
+      printf "%-40s %10.2f %10.2f %6.2f %10.3f %10.3f%s\n", name, old_p50[name], new_p50[name], ratio, old_mbs[name], new_mbs[name], new_status[name] == "ok" ? "" : " (" new_status[name] ")"
+    }
+  }' "$1" "$2"
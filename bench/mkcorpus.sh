@@ -0,0 +1,193 @@
+#!/bin/bash
+
+#
+# Copyright (c) 2022 Chandresh Soni
+#
+# Licensed under Apache License v2.0.  See the file "LICENSE" for more
+# information.
+#
+
+# Generate the benchmark corpus in the given directory.
+#
+# Everything is generated deterministically from the public-domain text below,
+# so that results can be compared across commits without shipping binary
+# documents.  Formats that need an external tool (ODT needs zip, PNG needs
+# ImageMagick) are skipped when the tool is missing.
+
+if [ $# != 1 ]; then
+  echo "Usage: $0 corpus-directory" >&2
+  exit 1
+fi
+
+mkdir -p "$1" || exit 1
+OUT=$(cd "$1" && pwd)
+
+# Byte-oriented output from awk
+export LC_ALL=C
+
+# From the United States Declaration of Independence (public domain)
+PARAGRAPH="When in the Course of human events, it becomes necessary for one people to dissolve the political bands which have connected them with another, and to assume among the powers of the earth, the separate and equal station to which the Laws of Nature and of Nature's God entitle them, a decent respect to the opinions of mankind requires that they should declare the causes which impel them to the separation. We hold these truths to be self-evident, that all men are created equal, that they are endowed by their Creator with certain unalienable Rights, that among these are Life, Liberty and the pursuit of Happiness."
+
+# Approximate printed pages of text: a 40x25 braille page holds about 700
+# characters of contracted text, so three paragraphs make about one page.
+PARAS_PER_PAGE=3
+
+# Plain text, paragraphs separated by blank lines
+mktext() {
+  awk -v n="$1" -v p="$PARAGRAPH" 'BEGIN {
+    for (i = 1; i <= n; i ++)
+      printf "%d. %s\n\n", i, p
+  }'
+}
+
+# BRF volume: 25 lines of up to 32 cells per page, pages separated by FF
+mkbrf() {
+  awk -v n="$1" 'BEGIN {
+    srand(1)
+    cells = "abcdefghijklmnopqrstuvwxyz0123456789,;:./()!?-\"#$%&*+<=>@[]^_"
+    for (p = 1; p <= n; p ++) {
+      for (l = 1; l <= 25; l ++) {
+        len = 20 + int(rand() * 13)
+        line = ""
+        for (c = 0; c < len; c ++) {
+          if (rand() < 0.18)
+            line = line " "
+          else
+            line = line substr(cells, 1 + int(rand() * length(cells)), 1)
+        }
+        printf "%s\r\n", line
+      }
+      if (p < n)
+        printf "\f"
+    }
+  }'
+}
+
+# UBRL graphics: pages of 4-dot braille pattern lines (U+2800-U+28FF)
+mkubrl() {
+  awk -v n="$1" 'BEGIN {
+    for (p = 1; p <= n; p ++) {
+      for (l = 0; l < 25; l ++) {
+        for (c = 0; c < 40; c ++) {
+          v = (c * 7 + l * 13 + p) % 256
+          if ((c - 20) * (c - 20) + (l - 12) * (l - 12) > 80)
+            v = 0
+          printf "%c%c%c", 226, 160 + int(v / 64), 128 + v % 64
+        }
+        printf "\n"
+      }
+      if (p < n)
+        printf "\f"
+    }
+  }'
+}
+
+# Minimal PDF with one text paragraph per page, offsets computed for xref
+mkpdf() {
+  awk -v n="$1" -v p="$PARAGRAPH" 'BEGIN {
+    gsub(/[()\\]/, "", p)
+    out = "%PDF-1.4\n"
+    nobj = 3 + 2 * n
+    off[1] = length(out)
+    out = out "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n"
+    kids = ""
+    for (i = 0; i < n; i ++)
+      kids = kids (4 + 2 * i) " 0 R "
+    off[2] = length(out)
+    out = out "2 0 obj\n<< /Type /Pages /Kids [" kids "] /Count " n " >>\nendobj\n"
+    off[3] = length(out)
+    out = out "3 0 obj\n<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>\nendobj\n"
+    for (i = 0; i < n; i ++) {
+      page = 4 + 2 * i
+      stream = "BT /F1 10 Tf 50 750 Td 12 TL"
+      words = split(p, w, " ")
+      line = ""
+      for (k = 1; k <= words; k ++) {
+        if (length(line) + length(w[k]) > 90) {
+          stream = stream " (" line ") \047"
+          line = ""
+        }
+        line = line w[k] " "
+      }
+      stream = stream " (" line ") \047 ET"
+      off[page] = length(out)
+      out = out page " 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Resources << /Font << /F1 3 0 R >> >> /Contents " (page + 1) " 0 R >>\nendobj\n"
+      off[page + 1] = length(out)
+      out = out (page + 1) " 0 obj\n<< /Length " length(stream) " >>\nstream\n" stream "\nendstream\nendobj\n"
+    }
+    xref = length(out)
+    printf "%s", out
+    printf "xref\n0 %d\n0000000000 65535 f \n", nobj + 1
+    for (i = 1; i <= nobj; i ++)
+      printf "%010d 00000 n \n", off[i]
+    printf "trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%d\n%%%%EOF\n", nobj + 1, xref
+  }'
+}
+
+# Grayscale test image (ASCII PGM): a disc and a ramp
+mkpgm() {
+  awk -v w="$1" -v h="$2" 'BEGIN {
+    printf "P2\n%d %d\n255\n", w, h
+    for (y = 0; y < h; y ++) {
+      for (x = 0; x < w; x ++) {
+        dx = x - w / 2; dy = y - h / 2
+        v = (dx * dx + dy * dy < (h / 3) * (h / 3)) ? 0 : int(255 * x / w)
+        printf "%d%s", v, (x + 1) % 16 ? " " : "\n"
+      }
+      printf "\n"
+    }
+  }'
+}
+
+for PAGES in 1 10 100
+do
+  mktext $(($PAGES * $PARAS_PER_PAGE)) > "$OUT/text-$PAGES.txt"
+  {
+    echo "<html><head><title>Benchmark</title></head><body>"
+    mktext $(($PAGES * $PARAS_PER_PAGE)) | sed -e 's/^\(..*\)$/<p>\1<\/p>/'
+    echo "</body></html>"
+  } > "$OUT/html-$PAGES.html"
+done
+
+# Tabs in preformatted text with an indent of half the line width: at 10
+# columns the tab stops cannot be reached (htmltotext used to loop forever)
+{
+  printf '<ul><ul><ul><pre>\tx\ty\n</pre></ul></ul></ul>\n'
+  printf '<dl><dd><dl><dd><pre>\t\tab\tc\n</pre></dd></dl></dd></dl>\n'
+} > "$OUT/html-pre-indent.html"
+
+for PAGES in 1 10
+do
+  mkpdf $(($PAGES * $PARAS_PER_PAGE)) > "$OUT/pdf-$PAGES.pdf"
+  mkubrl $PAGES > "$OUT/ubrl-$PAGES.ubrl"
+done
+
+for PAGES in 1 10 100 1000
+do
+  mkbrf $PAGES > "$OUT/brf-$PAGES.brf"
+done
+
+mkpgm 640 480 > "$OUT/image-640.pgm"
+mkpgm 2480 3508 > "$OUT/image-2480.pgm"
+
+if type convert > /dev/null 2>&1
+then
+  convert "$OUT/image-2480.pgm" "$OUT/image-2480.png"
+fi
+
+if type zip > /dev/null 2>&1
+then
+  ODT=$(mktemp -d "${TMPDIR:-/tmp}/mkcorpus.XXXXXX")
+  printf %s "application/vnd.oasis.opendocument.text" > "$ODT/mimetype"
+  {
+    echo '<?xml version="1.0" encoding="UTF-8"?>'
+    echo '<office:document-content xmlns:office="urn:oasis:names:tc:opendocument:xmlns:office:1.0" xmlns:text="urn:oasis:names:tc:opendocument:xmlns:text:1.0" office:version="1.2"><office:body><office:text>'
+    mktext $((10 * $PARAS_PER_PAGE)) | sed -n -e 's/^\(..*\)$/<text:p>\1<\/text:p>/p'
+    echo '</office:text></office:body></office:document-content>'
+  } > "$ODT/content.xml"
+  rm -f "$OUT/odt-10.odt"
+  (cd "$ODT" && zip -q -X -0 "$OUT/odt-10.odt" mimetype && zip -q -X "$OUT/odt-10.odt" content.xml)
+  rm -rf "$ODT"
+fi
+
+exit 0
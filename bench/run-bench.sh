@@ -0,0 +1,283 @@
+#!/bin/bash
+
+#
+# Copyright (c) 2022 Chandresh Soni
+#
+# Licensed under Apache License v2.0.  See the file "LICENSE" for more
+# information.
+#
+
+# Benchmark the braille filters and drivers from the build tree.
+#
+# Every stage is run in isolation on the corpus from mkcorpus.sh, then the
+# usual CUPS chains are run end to end.  PPDs are compiled from drv/*.drv so
+# that option defaults are the same on every run.  Results are written as one
+# JSON object per line, see compare.sh to compare two result files.
+#
+# Usage: run-bench.sh [--srcdir=DIR] [--builddir=DIR] [--output=FILE]
+#                     [--runs=N] [--filter=REGEX] [--programs="LIST"]
+#
+# CUPS_DATADIR and CUPS_SERVERBIN must be the values the filters were
+# configured with, they are replaced with the build tree.  The helper
+# programs of the filters (--programs, "make bench" passes the ones it
+# built) are taken from the build tree as well; a helper which was not built
+# is reported, the filters then use their fallback or an installed copy.
+
+SRCDIR=$(cd "$(dirname "$0")/.." && pwd)
+BUILDDIR=$PWD
+OUTPUT=bench-results.json
+RUNS=5
+FILTER=
+HELPERS="brfstat htmltotext pbmtobrf unzipxml freedots-worker pdftotextpar imagedecode"
+PROGRAMS=$HELPERS
+
+for ARG in "$@"
+do
+  case "$ARG" in
+    --srcdir=*) SRCDIR=${ARG#*=} ;;
+    --builddir=*) BUILDDIR=${ARG#*=} ;;
+    --output=*) OUTPUT=${ARG#*=} ;;
+    --runs=*) RUNS=${ARG#*=} ;;
+    --filter=*) FILTER=${ARG#*=} ;;
+    --programs=*) PROGRAMS=${ARG#*=} ;;
+    *)
+      echo "Usage: $0 [--srcdir=DIR] [--builddir=DIR] [--output=FILE] [--runs=N] [--filter=REGEX] [--programs=LIST]" >&2
+      exit 1
+      ;;
+  esac
+done
+
+for TOOL in ppdc awk
+do
+  if ! type $TOOL > /dev/null 2>&1
+  then
+    echo "ERROR: $TOOL is needed to run the benchmarks" >&2
+    exit 1
+  fi
+done
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/brfbench.XXXXXX")
+trap -- 'rm -rf "$WORK"' EXIT
+
+export LC_ALL=C
+
+#
+# Set up the build tree filters so that they source each other from $WORK
+#
+
+mkdir -p "$WORK/braille" "$WORK/filter" "$WORK/ppd" "$WORK/corpus"
+
+relocate() {
+  sed -e "s|${CUPS_DATADIR:-/usr/share/cups}/braille/|$WORK/braille/|g" \
+      -e "s|${CUPS_SERVERBIN:-/usr/lib/cups}/filter/index|$WORK/braille/index|g" \
+      < "$1" > "$2"
+  chmod +x "$2"
+}
+
+for SCRIPT in filter/cups-braille.sh driver/index/index.sh driver/index/indexv3.sh driver/index/indexv4.sh
+do
+  relocate "$BUILDDIR/$SCRIPT" "$WORK/braille/$(basename $SCRIPT)"
+done
+
+for SCRIPT in filter/texttobrf filter/imagetobrf filter/vectortobrf filter/brftopagedbrf \
+	      filter/musicxmltobrf driver/generic/brftoembosser \
+	      driver/index/textbrftoindexv3 driver/index/imageubrltoindexv3 \
+	      driver/index/imageubrltoindexv4
+do
+  relocate "$BUILDDIR/$SCRIPT" "$WORK/filter/$(basename $SCRIPT)"
+done
+ln -s textbrftoindexv3 "$WORK/filter/textbrftoindexv4"
+ln -s imagetobrf "$WORK/filter/imagetoubrl"
+ln -s vectortobrf "$WORK/filter/vectortoubrl"
+for PROGRAM in $PROGRAMS
+do
+  [ -x "$BUILDDIR/$PROGRAM" ] && ln -s "$BUILDDIR/$PROGRAM" "$WORK/filter/$PROGRAM"
+done
+for PROGRAM in $HELPERS
+do
+  if [ ! -e "$WORK/filter/$PROGRAM" ]
+  then
+    echo "NOTE: $PROGRAM not built, measuring $(type -p $PROGRAM > /dev/null 2>&1 && echo "the installed copy" || echo "the fallback")" >&2
+  fi
+done
+
+export PATH="$WORK/filter:$PATH"
+
+#
+# PPDs and corpus
+#
+
+if ! ppdc -d "$WORK/ppd" \
+	  -I "$SRCDIR/driver/common" -I "$SRCDIR/driver/index" \
+	  -I "$SRCDIR/filter" -I "$BUILDDIR/filter" \
+	  "$SRCDIR"/drv/*.drv
+then
+  echo "ERROR: Unable to compile the PPDs" >&2
+  exit 1
+fi
+
+bash "$SRCDIR/bench/mkcorpus.sh" "$WORK/corpus" || exit 1
+
+#
+# Measurement
+#
+
+if /usr/bin/time -f %M true > /dev/null 2>&1
+then
+  GNUTIME=/usr/bin/time
+else
+  GNUTIME=
+  echo "WARNING: GNU time not found, peak RSS will not be reported" >&2
+fi
+
+COMMIT=$(git -C "$SRCDIR" rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+{
+  printf '{"type":"run","commit":"%s","date":"%s","host":"%s","cpus":%d,"runs":%d}\n' \
+    "$COMMIT" "$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$(uname -nm | tr ' ' '-')" \
+    "$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)" "$RUNS"
+} > "$OUTPUT"
+
+# bench NAME PPD CONTENT_TYPE OPTIONS INPUT COMMAND...
+#
+# The command is run through bash with the usual CUPS filter environment,
+# "$FILE" being the input document.  Its output is discarded.
+bench() {
+  local NAME=$1 BPPD=$2 BTYPE=$3 BOPTIONS=$4 BINPUT=$5
+  shift 5
+
+  if [ -n "$FILTER" ] && ! [[ $NAME =~ $FILTER ]]
+  then
+    return
+  fi
+
+  if [ ! -f "$BINPUT" ]
+  then
+    echo "SKIP: $NAME (no input)" >&2
+    return
+  fi
+
+  local SIZE=$(wc -c < "$BINPUT") I START END RSS MAXRSS=0 STATUS=ok
+  local TIMES="$WORK/times" LOG="$WORK/log"
+
+  : > "$TIMES"
+  for ((I = 0; I < RUNS; I ++))
+  do
+    START=$(date +%s%N)
+    if [ -n "$GNUTIME" ]
+    then
+      PPD="$WORK/ppd/$BPPD" CONTENT_TYPE=$BTYPE FINAL_CONTENT_TYPE=$BTYPE OPTIONS="$BOPTIONS" FILE="$BINPUT" \
+	$GNUTIME -f %M -o "$WORK/rss" bash -c "$*" > /dev/null 2> "$LOG"
+    else
+      PPD="$WORK/ppd/$BPPD" CONTENT_TYPE=$BTYPE FINAL_CONTENT_TYPE=$BTYPE OPTIONS="$BOPTIONS" FILE="$BINPUT" \
+	bash -c "$*" > /dev/null 2> "$LOG"
+    fi
+    if [ $? != 0 ]
+    then
+      STATUS=failed
+    fi
+    END=$(date +%s%N)
+    echo $(( (END - START) / 1000 )) >> "$TIMES"
+
+    if [ -n "$GNUTIME" ]
+    then
+      RSS=$(tail -n 1 "$WORK/rss")
+      [ "$RSS" -gt "$MAXRSS" ] 2> /dev/null && MAXRSS=$RSS
+    fi
+  done
+
+  if [ $STATUS != ok ]
+  then
+    echo "FAIL: $NAME" >&2
+    grep "^ERROR" "$LOG" | head -n 3 >&2
+  fi
+
+  sort -n "$TIMES" | awk -v name="$NAME" -v size="$SIZE" -v rss="${GNUTIME:+$MAXRSS}" -v status="$STATUS" '
+    { t[NR] = $1; total += $1 }
+    END {
+      p50 = t[int((NR * 50 + 99) / 100)]
+      p99 = t[int((NR * 99 + 99) / 100)]
+      secs = total / 1000000
+      printf "{\"type\":\"bench\",\"name\":\"%s\",\"status\":\"%s\",\"bytes\":%d,\"runs\":%d,", name, status, size, NR
+      printf "\"jobs_per_sec\":%.3f,\"mb_per_sec\":%.3f,\"p50_ms\":%.2f,\"p99_ms\":%.2f,", NR / secs, size * NR / secs / 1000000, p50 / 1000, p99 / 1000
+      printf "\"max_rss_kb\":%s}\n", rss == "" ? "null" : rss
+    }' | tee -a "$OUTPUT"
+}
+
+C=$WORK/corpus
+TEXTOPTS="LibLouis=en-us-g1.ctb"
+
+#
+# Stages in isolation
+#
+
+for N in 1 10 100
+do
+  bench "texttobrf/text-$N" gen-brf.ppd text/plain "$TEXTOPTS" "$C/text-$N.txt" \
+    'texttobrf 1 bench bench 1 "$OPTIONS" "$FILE"'
+  bench "texttobrf/html-$N" gen-brf.ppd text/html "$TEXTOPTS" "$C/html-$N.html" \
+    'texttobrf 1 bench bench 1 "$OPTIONS" "$FILE"'
+done
+
+bench "htmltotext/pre-indent" gen-brf.ppd text/html "" "$C/html-pre-indent.html" \
+  'timeout 10 htmltotext -w 10 "$FILE"'
+
+for N in 1 10
+do
+  bench "texttobrf/pdf-$N" gen-brf.ppd application/pdf "$TEXTOPTS" "$C/pdf-$N.pdf" \
+    'texttobrf 1 bench bench 1 "$OPTIONS" "$FILE"'
+done
+
+bench "texttobrf/odt-10" gen-brf.ppd application/vnd.oasis.opendocument.text "$TEXTOPTS" "$C/odt-10.odt" \
+  'texttobrf 1 bench bench 1 "$OPTIONS" "$FILE"'
+
+for IMG in image-640.pgm image-2480.pgm image-2480.png
+do
+  bench "imagetobrf/${IMG%.*}" gen-brf.ppd image/x-portable-graymap "" "$C/$IMG" \
+    'imagetobrf 1 bench bench 1 "$OPTIONS" "$FILE"'
+  bench "imagetoubrl/${IMG%.*}" gen-ubrl.ppd image/x-portable-graymap "" "$C/$IMG" \
+    'imagetoubrl 1 bench bench 1 "$OPTIONS" "$FILE"'
+done
+
+for N in 1 10 100 1000
+do
+  bench "brfstat/brf-$N" gen-brf.ppd application/vnd.cups-brf "" "$C/brf-$N.brf" \
+    'brfstat "$FILE"'
+  bench "brftopagedbrf/brf-$N" gen-brf.ppd application/vnd.cups-brf "" "$C/brf-$N.brf" \
+    'brftopagedbrf 1 bench bench 1 "$OPTIONS" "$FILE"'
+  bench "brftopagedbrf-range/brf-$N" gen-brf.ppd application/vnd.cups-brf "page-ranges=1-10" "$C/brf-$N.brf" \
+    'brftopagedbrf 1 bench bench 1 "$OPTIONS" "$FILE"'
+  bench "textbrftoindexv3/brf-$N" ibasicd3.ppd application/vnd.cups-paged-brf "$TEXTOPTS" "$C/brf-$N.brf" \
+    'textbrftoindexv3 1 bench bench 1 "$OPTIONS" "$FILE"'
+  bench "textbrftoindexv4/brf-$N" ieveres4.ppd application/vnd.cups-paged-brf "$TEXTOPTS" "$C/brf-$N.brf" \
+    'textbrftoindexv4 1 bench bench 1 "$OPTIONS" "$FILE"'
+done
+
+for N in 1 10
+do
+  bench "imageubrltoindexv3/ubrl-$N" ibasicd3.ppd image/vnd.cups-ubrl "" "$C/ubrl-$N.ubrl" \
+    'imageubrltoindexv3 1 bench bench 1 "$OPTIONS" "$FILE"'
+  bench "imageubrltoindexv4/ubrl-$N" ieveres4.ppd image/vnd.cups-ubrl "" "$C/ubrl-$N.ubrl" \
+    'imageubrltoindexv4 1 bench bench 1 "$OPTIONS" "$FILE"'
+done
+
+#
+# End to end, as chained by CUPS from braille.convs and the PPD filters
+#
+
+for N in 1 10 100
+do
+  bench "e2e-indexv4/text-$N" ieveres4.ppd text/plain "$TEXTOPTS" "$C/text-$N.txt" \
+    'texttobrf 1 bench bench 1 "$OPTIONS" "$FILE" | brftopagedbrf 1 bench bench 1 "$OPTIONS" | textbrftoindexv4 1 bench bench 1 "$OPTIONS"; exit $((PIPESTATUS[0] | PIPESTATUS[1] | PIPESTATUS[2]))'
+  bench "e2e-generic/text-$N" gen-brf.ppd text/plain "$TEXTOPTS" "$C/text-$N.txt" \
+    'texttobrf 1 bench bench 1 "$OPTIONS" "$FILE" | brftopagedbrf 1 bench bench 1 "$OPTIONS" | brftoembosser 1 bench bench 1 "$OPTIONS"; exit $((PIPESTATUS[0] | PIPESTATUS[1] | PIPESTATUS[2]))'
+done
+
+bench "e2e-indexv4/pdf-10" ieveres4.ppd application/pdf "$TEXTOPTS" "$C/pdf-10.pdf" \
+  'texttobrf 1 bench bench 1 "$OPTIONS" "$FILE" | brftopagedbrf 1 bench bench 1 "$OPTIONS" | textbrftoindexv4 1 bench bench 1 "$OPTIONS"; exit $((PIPESTATUS[0] | PIPESTATUS[1] | PIPESTATUS[2]))'
+
+bench "e2e-indexv4/image-2480" ieveres4.ppd image/x-portable-graymap "" "$C/image-2480.pgm" \
+  'imagetoubrl 1 bench bench 1 "$OPTIONS" "$FILE" | brftopagedbrf 1 bench bench 1 "$OPTIONS" | imageubrltoindexv4 1 bench bench 1 "$OPTIONS"; exit $((PIPESTATUS[0] | PIPESTATUS[1] | PIPESTATUS[2]))'
+
+echo "Results written to $OUTPUT" >&2
+exit 0
@@ -0,0 +1,311 @@
+//
+// Per-job memory arena for the Braille Printer Application
+//
+// Copyright © 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Everything allocated for a job (job data, filter data, option arrays and
+// strings, chain nodes) comes from the job's arena and is released at once
+// when the job ends.  Released blocks are kept for the next jobs, so that a
+// job normally does not call malloc() at all.
+//
+
+//
+// Include necessary headers...
+//
+
+#include <pappl/pappl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include "brf-printer-app.h"
+
+
+//
+// Constants...
+//
+
+#define BRF_ARENA_BLOCK		16384	// Size of a standard block
+#define BRF_ARENA_CACHE		8	// Max number of cached blocks
+#define BRF_ARENA_ALIGN		sizeof(max_align_t)
+					// Alignment of allocations
+
+
+//
+// Local types...
+//
+
+typedef struct brf_arena_block_s	// Block of memory
+{
+  struct brf_arena_block_s *next;	// Next block
+  size_t		size,		// Usable size
+			used;		// Bytes used
+  max_align_t		data[];		// Memory
+} brf_arena_block_t;
+
+struct brf_arena_s			// Arena
+{
+  brf_arena_block_t	*blocks;	// Blocks, current block first
+};
+
+
+//
+// Local globals...
+//
+
+static pthread_mutex_t	brf_arena_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// Mutex for the block cache
+static brf_arena_block_t *brf_arena_cache = NULL;
+					// Cached standard blocks
+static int		brf_arena_num_cache = 0;
+					// Number of cached blocks
+
+
+//
+// Functions...
+//
+
+static brf_arena_block_t *brf_arena_block(size_t size);
+
+
+//
+// 'brf_arena_add_option()' - Add an option to an array in the arena.
+//
+// Works like cupsAddOption(), an existing option of the same name is
+// replaced.  The array is grown by doubling, the old copy stays in the arena.
+//
+
+int					// O - New number of options
+brf_arena_add_option(
+    brf_arena_t   *arena,		// I  - Arena
+    const char    *name,		// I  - Option name
+    const char    *value,		// I  - Option value
+    int           num_options,		// I  - Number of options
+    cups_option_t **options)		// IO - Options
+{
+  int		i;			// Looping var
+  cups_option_t	*temp;			// New array
+
+
+  for (i = 0; i < num_options; i ++)
+  {
+    if (!strcasecmp((*options)[i].name, name))
+    {
+      (*options)[i].value = brf_arena_strdup(arena, value);
+      return (num_options);
+    }
+  }
+
+  if (num_options == 0 || (num_options >= 8 && !(num_options & (num_options - 1))))
+  {
+    // Array is full (capacity is 8 or the next power of 2)
+    if ((temp = brf_arena_alloc(arena, (num_options ? 2 * (size_t)num_options : 8) * sizeof(cups_option_t))) == NULL)
+      return (num_options);
+
+    if (num_options)
+      memcpy(temp, *options, (size_t)num_options * sizeof(cups_option_t));
+
+    *options = temp;
+  }
+
+  (*options)[num_options].name  = brf_arena_strdup(arena, name);
+  (*options)[num_options].value = brf_arena_strdup(arena, value);
+
+  return (num_options + 1);
+}
+
+
+//
+// 'brf_arena_copy_options()' - Copy an option array into the arena.
+//
+// The copy can be extended with brf_arena_add_option().
+//
+
+int					// O - Number of options
+brf_arena_copy_options(
+    brf_arena_t   *arena,		// I - Arena
+    int           num_options,		// I - Number of options
+    cups_option_t *options,		// I - Options
+    cups_option_t **copy)		// O - Copy
+{
+  int		i;			// Looping var
+  size_t	size;			// Capacity of the copy
+
+
+  *copy = NULL;
+
+  if (num_options <= 0)
+    return (0);
+
+  // Same capacity as brf_arena_add_option() would have used
+  for (size = 8; size < (size_t)num_options; size *= 2);
+
+  if ((*copy = brf_arena_alloc(arena, size * sizeof(cups_option_t))) == NULL)
+    return (0);
+
+  for (i = 0; i < num_options; i ++)
+  {
+    (*copy)[i].name  = brf_arena_strdup(arena, options[i].name);
+    (*copy)[i].value = brf_arena_strdup(arena, options[i].value);
+  }
+
+  return (num_options);
+}
+
+
+//
+// 'brf_arena_alloc()' - Allocate zeroed memory from the arena.
+//
+
+void *					// O - Memory or `NULL` on error
+brf_arena_alloc(brf_arena_t *arena,	// I - Arena
+                size_t      size)	// I - Number of bytes
+{
+  brf_arena_block_t	*block = arena->blocks;
+					// Current block
+  void			*ptr;		// Allocated memory
+
+
+  size = (size + BRF_ARENA_ALIGN - 1) & ~(BRF_ARENA_ALIGN - 1);
+
+  if (block->size - block->used < size)
+  {
+    if ((block = brf_arena_block(size)) == NULL)
+      return (NULL);
+
+    if (block->size > BRF_ARENA_BLOCK)
+    {
+      // Keep filling the current block after a large allocation
+      block->next          = arena->blocks->next;
+      arena->blocks->next  = block;
+    }
+    else
+    {
+      block->next   = arena->blocks;
+      arena->blocks = block;
+    }
+  }
+
+  ptr         = (char *)block->data + block->used;
+  block->used += size;
+
+  memset(ptr, 0, size);
+
+  return (ptr);
+}
+
+
+//
+// 'brf_arena_delete()' - Release an arena and everything allocated from it.
+//
+
+void
+brf_arena_delete(brf_arena_t *arena)	// I - Arena
+{
+  brf_arena_block_t	*block,		// Current block
+			*next;		// Next block
+
+
+  if (!arena)
+    return;
+
+  pthread_mutex_lock(&brf_arena_mutex);
+
+  for (block = arena->blocks; block; block = next)
+  {
+    next = block->next;
+
+    if (block->size == BRF_ARENA_BLOCK && brf_arena_num_cache < BRF_ARENA_CACHE)
+    {
+      block->next     = brf_arena_cache;
+      brf_arena_cache = block;
+      brf_arena_num_cache ++;
+    }
+    else
+      free(block);
+  }
+
+  pthread_mutex_unlock(&brf_arena_mutex);
+}
+
+
+//
+// 'brf_arena_new()' - Create an arena.
+//
+
+brf_arena_t *				// O - Arena or `NULL` on error
+brf_arena_new(void)
+{
+  brf_arena_block_t	*block;		// First block
+  brf_arena_t		*arena;		// Arena
+
+
+  if ((block = brf_arena_block(0)) == NULL)
+    return (NULL);
+
+  // The arena lives in its own first block
+  arena         = (brf_arena_t *)block->data;
+  arena->blocks = block;
+  block->used   = (sizeof(brf_arena_t) + BRF_ARENA_ALIGN - 1) & ~(BRF_ARENA_ALIGN - 1);
+
+  return (arena);
+}
+
+
+//
+// 'brf_arena_strdup()' - Copy a string into the arena.
+//
+
+char *					// O - Copy or `NULL`
+brf_arena_strdup(brf_arena_t *arena,	// I - Arena
+                 const char  *s)	// I - String
+{
+  size_t	len;			// Length of string
+  char		*copy;			// Copy
+
+
+  if (!s)
+    return (NULL);
+
+  len = strlen(s) + 1;
+
+  if ((copy = brf_arena_alloc(arena, len)) != NULL)
+    memcpy(copy, s, len);
+
+  return (copy);
+}
+
+
+//
+// 'brf_arena_block()' - Get an empty block from the cache or allocate one.
+//
+
+static brf_arena_block_t *		// O - Block or `NULL` on error
+brf_arena_block(size_t size)		// I - Minimum usable size
+{
+  brf_arena_block_t	*block = NULL;	// Block
+
+
+  if (size <= BRF_ARENA_BLOCK)
+  {
+    size = BRF_ARENA_BLOCK;
+
+    pthread_mutex_lock(&brf_arena_mutex);
+    if ((block = brf_arena_cache) != NULL)
+    {
+      brf_arena_cache = block->next;
+      brf_arena_num_cache --;
+    }
+    pthread_mutex_unlock(&brf_arena_mutex);
+  }
+
+  if (!block && (block = malloc(sizeof(brf_arena_block_t) + size)) == NULL)
+    return (NULL);
+
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+
+  return (block);
+}
@@ -0,0 +1,128 @@
+//
+// Embossing time and paper estimates for the Braille Printer Application
+//
+// Copyright © 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// The page geometry follows filter/cups-braille.sh: the number of lines per
+// page comes from the printable area, the text dot distance, the number of
+// dots and the line spacing.  Speeds are nominal per-model figures.
+//
+
+//
+// Include necessary headers...
+//
+
+#include <pappl/pappl.h>
+#include "brf-printer-app.h"
+
+
+//
+// Local types...
+//
+
+typedef struct brf_estimate_profile_s	// Embosser speed profile
+{
+  const char	*prefix;		// Driver name prefix
+  double	cps;			// Characters per second
+  double	page_time;		// Seconds per page (feed, new page)
+} brf_estimate_profile_t;
+
+
+//
+// Local globals...
+//
+
+static const brf_estimate_profile_t brf_estimate_profiles[] =
+{					// Profiles, first match wins
+  { "indexv3_4waves",	400.0,	1.0 },
+  { "indexv3_4x4pro",	200.0,	2.0 },
+  { "indexv4_brlbox",	200.0,	2.0 },
+  { "indexv3_",		100.0,	3.0 },
+  { "indexv4_",		120.0,	3.0 },
+  { "",			50.0,	5.0 }	// Unknown embosser
+};
+
+
+//
+// 'brf_estimate_job()' - Estimate the embossing time and paper of a job.
+//
+// The result is reported as the job impressions and the job message, which
+// PAPPL shows both over IPP (job-state-message) and in the web interface,
+// and returned for the job scheduler.
+//
+
+double					// O - Embossing time in seconds
+brf_estimate_job(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    const brf_scan_t   *scan)		// I - BRF statistics
+{
+  const char		*driver_name,	// Driver name
+			*val;		// Vendor option value
+  const brf_estimate_profile_t *profile;// Speed profile
+  int			dot_distance,	// Text dot distance (1/100mm)
+			dots,		// 6 or 8 dots
+			line_spacing,	// Line spacing (1/100mm)
+			height,		// Printable height (1/100mm)
+			lines_per_page,	// Lines per page
+			copies;		// Number of copies
+  unsigned long		pages,		// Embossed pages
+			sheets;		// Sheets of paper
+  double		seconds;	// Embossing time
+
+
+  driver_name = papplPrinterGetDriverName(papplJobGetPrinter(job));
+
+  for (profile = brf_estimate_profiles; profile->prefix[0]; profile ++)
+  {
+    if (!strncmp(driver_name, profile->prefix, strlen(profile->prefix)))
+      break;
+  }
+
+  // Text geometry, see cups-braille.sh...
+  dot_distance = (val = cupsGetOption("text-dot-distance", options->num_vendor, options->vendor)) != NULL ? atoi(val) : 250;
+  dots         = (val = cupsGetOption("text-dots", options->num_vendor, options->vendor)) != NULL ? atoi(val) : 6;
+  line_spacing = (val = cupsGetOption("line-spacing", options->num_vendor, options->vendor)) != NULL ? atoi(val) : 500;
+
+  if (dot_distance != 220 && dot_distance != 320)
+    dot_distance = 250;
+
+  if (dots != 8)
+    dots = 6;
+
+  height = options->media.size_length - options->media.top_margin - options->media.bottom_margin;
+
+  if (height > 0 && line_spacing > 0)
+    lines_per_page = (height + line_spacing) / (dot_distance * (dots / 2 - 1) + line_spacing);
+  else
+    lines_per_page = 0;
+
+  // Overlong pages are continued on the next sheet by the embosser...
+  pages = scan->pages;
+  if (lines_per_page > 0 && pages < (scan->lines + (unsigned long)lines_per_page - 1) / (unsigned long)lines_per_page)
+    pages = (scan->lines + (unsigned long)lines_per_page - 1) / (unsigned long)lines_per_page;
+
+  copies = options->copies > 1 ? options->copies : 1;
+
+  if (options->sides & (PAPPL_SIDES_TWO_SIDED_LONG_EDGE | PAPPL_SIDES_TWO_SIDED_SHORT_EDGE))
+    sheets = (pages + 1) / 2;
+  else
+    sheets = pages;
+
+  seconds = copies * ((double)scan->cells / profile->cps + (double)pages * profile->page_time);
+
+  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Estimate: %lu cells, %lu lines, %d lines per page, %lu pages, %lu sheets, %d copies, %.0f seconds.", scan->cells, scan->lines, lines_per_page, pages, sheets, copies, seconds);
+
+  if (pages > 0)
+    papplJobSetImpressions(job, (int)pages);
+
+  if (seconds >= 3600.0)
+    papplJobSetMessage(job, "%lu pages on %lu sheets, about %dh%02d to emboss.", pages, sheets * (unsigned long)copies, (int)(seconds / 3600.0), ((int)seconds % 3600) / 60);
+  else
+    papplJobSetMessage(job, "%lu pages on %lu sheets, about %d min to emboss.", pages, sheets * (unsigned long)copies, (int)(seconds + 59.0) / 60);
+
+  return (seconds);
+}
@@ -0,0 +1,392 @@
+//
+// Filter chain instrumentation for the Braille Printer Application
+//
+// Copyright © 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// cfFilterChain() runs the filter functions in child processes, so each
+// stage is wrapped by a function that measures it from inside that child and
+// stores the results in a shared anonymous mapping.  The filter gets its
+// input as is; the bytes it read, including those of the external filter
+// processes it waited for, come from the "rchar" counter of /proc/self/io.
+// A stage which runs in the Printer Application itself only has its wall
+// clock time and status measured, the process counters would include all
+// other jobs.
+//
+
+//
+// Include necessary headers...
+//
+
+#include <pappl/pappl.h>
+#include <cupsfilters/filter.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include "brf-printer-app.h"
+
+
+//
+// Constants...
+//
+
+#define BRF_METRICS_MAX_STAGES	16	// Max stages in a chain
+#define BRF_METRICS_MAX_NAMES	32	// Max distinct stage names
+
+
+//
+// Local types...
+//
+
+typedef struct brf_stage_stats_s	// Stage results, in shared memory
+{
+  int			done;		// Stage finished?
+  int			forked;		// Stage ran in a child process?
+  int			status;		// Exit status of the filter function
+  unsigned long long	bytes_in;	// Bytes read by the stage
+  long long		wall_ns,	// Wall clock time
+			user_us,	// User CPU time
+			sys_us;		// System CPU time
+  long			maxrss_kb;	// Max RSS of external filter processes
+} brf_stage_stats_t;
+
+typedef struct brf_stage_s		// Wrapped stage
+{
+  cf_filter_filter_in_chain_t filter;	// Wrapper, as added to the chain
+  cf_filter_filter_in_chain_t *inner;	// Wrapped filter
+  brf_stage_stats_t	*stats;		// Results (shared)
+  pid_t			pid;		// Printer Application process
+} brf_stage_t;
+
+struct brf_metrics_s			// Instrumented chain for a job
+{
+  int			num_stages;	// Number of stages
+  brf_stage_t		stages[BRF_METRICS_MAX_STAGES];
+					// Stages
+  brf_stage_stats_t	*stats;		// Shared results for all stages
+  cups_array_t		*chain;		// Chain of wrappers
+};
+
+typedef struct brf_metrics_total_s	// Aggregate counters for a stage name
+{
+  char			name[64];	// Stage name
+  unsigned long		runs,		// Number of runs
+			failures;	// Number of failed runs
+  unsigned long long	bytes_in;	// Total bytes
+  double		wall,		// Total wall clock seconds
+			cpu;		// Total CPU seconds
+  long			maxrss_kb;	// Highest max RSS seen
+} brf_metrics_total_t;
+
+//
+// Local globals...
+//
+
+static pthread_mutex_t		brf_metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// Mutex for the totals
+static int			brf_metrics_num_totals = 0;
+					// Number of stage names
+static brf_metrics_total_t	brf_metrics_totals[BRF_METRICS_MAX_NAMES];
+					// Totals per stage name
+static unsigned long		brf_metrics_jobs = 0;
+					// Number of instrumented jobs
+
+
+//
+// Local functions...
+//
+
+static long long brf_metrics_ns(const struct timespec *start, const struct timespec *end);
+static bool	brf_metrics_page(pappl_client_t *client, void *data);
+static unsigned long long brf_metrics_rchar(void);
+static int	brf_metrics_stage(int inputfd, int outputfd, int inputseekable, cf_filter_data_t *data, void *parameters);
+
+
+//
+// 'brf_metrics_delete()' - Log per-stage results, update the totals and free
+//                          an instrumented chain.
+//
+
+void
+brf_metrics_delete(
+    brf_metrics_t *metrics,		// I - Instrumented chain
+    pappl_job_t   *job)			// I - Job
+{
+  int			i, j;		// Looping vars
+  brf_stage_stats_t	*stats;		// Stage results
+
+
+  if (!metrics)
+    return;
+
+  pthread_mutex_lock(&brf_metrics_mutex);
+
+  brf_metrics_jobs ++;
+
+  for (i = 0; i < metrics->num_stages; i ++)
+  {
+    const char *name = metrics->stages[i].inner->name ? metrics->stages[i].inner->name : "unnamed";
+
+    stats = metrics->stats + i;
+
+    if (!stats->done)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_INFO, "Stage %s: did not finish.", name);
+      continue;
+    }
+
+    if (stats->forked)
+      papplLogJob(job, PAPPL_LOGLEVEL_INFO, "Stage %s: status %d, %.3fs wall, %.3fs user, %.3fs system, %llu bytes read, max RSS %ldkB.", name, stats->status, stats->wall_ns / 1e9, stats->user_us / 1e6, stats->sys_us / 1e6, stats->bytes_in, stats->maxrss_kb);
+    else
+      papplLogJob(job, PAPPL_LOGLEVEL_INFO, "Stage %s: status %d, %.3fs wall.", name, stats->status, stats->wall_ns / 1e9);
+
+    for (j = 0; j < brf_metrics_num_totals; j ++)
+    {
+      if (!strcmp(brf_metrics_totals[j].name, name))
+        break;
+    }
+
+    if (j >= brf_metrics_num_totals)
+    {
+      if (j >= BRF_METRICS_MAX_NAMES)
+        continue;
+
+      papplCopyString(brf_metrics_totals[j].name, name, sizeof(brf_metrics_totals[j].name));
+      brf_metrics_num_totals ++;
+    }
+
+    brf_metrics_totals[j].runs ++;
+    if (stats->status)
+      brf_metrics_totals[j].failures ++;
+    brf_metrics_totals[j].bytes_in += stats->bytes_in;
+    brf_metrics_totals[j].wall     += stats->wall_ns / 1e9;
+    brf_metrics_totals[j].cpu      += (stats->user_us + stats->sys_us) / 1e6;
+    if (stats->maxrss_kb > brf_metrics_totals[j].maxrss_kb)
+      brf_metrics_totals[j].maxrss_kb = stats->maxrss_kb;
+  }
+
+  pthread_mutex_unlock(&brf_metrics_mutex);
+
+  cupsArrayDelete(metrics->chain);
+  munmap(metrics->stats, BRF_METRICS_MAX_STAGES * sizeof(brf_stage_stats_t));
+  free(metrics);
+}
+
+
+//
+// 'brf_metrics_new()' - Wrap every filter of a chain with instrumentation.
+//
+// The returned chain must be passed to cfFilterChain() instead of the
+// original one.
+//
+
+brf_metrics_t *				// O - Instrumented chain or `NULL` on error
+brf_metrics_new(cups_array_t *chain)	// I - Filter chain
+{
+  brf_metrics_t			*metrics;// Instrumented chain
+  cf_filter_filter_in_chain_t	*filter;// Current filter
+  brf_stage_t			*stage;	// Current stage
+
+
+  if (cupsArrayCount(chain) > BRF_METRICS_MAX_STAGES || (metrics = calloc(1, sizeof(brf_metrics_t))) == NULL)
+    return (NULL);
+
+  if ((metrics->stats = mmap(NULL, BRF_METRICS_MAX_STAGES * sizeof(brf_stage_stats_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+  {
+    free(metrics);
+    return (NULL);
+  }
+
+  metrics->chain = cupsArrayNew(NULL, NULL);
+
+  for (filter = (cf_filter_filter_in_chain_t *)cupsArrayFirst(chain); filter; filter = (cf_filter_filter_in_chain_t *)cupsArrayNext(chain))
+  {
+    stage = metrics->stages + metrics->num_stages;
+
+    stage->inner             = filter;
+    stage->stats             = metrics->stats + metrics->num_stages;
+    stage->pid               = getpid();
+    stage->filter.function   = brf_metrics_stage;
+    stage->filter.parameters = stage;
+    stage->filter.name       = filter->name;
+
+    cupsArrayAdd(metrics->chain, &stage->filter);
+    metrics->num_stages ++;
+  }
+
+  return (metrics);
+}
+
+
+//
+// 'brf_metrics_chain()' - Return the instrumented filter chain.
+//
+
+cups_array_t *				// O - Filter chain
+brf_metrics_chain(brf_metrics_t *metrics)// I - Instrumented chain
+{
+  return (metrics->chain);
+}
+
+
+//
+// 'brf_metrics_register()' - Add the metrics page to the web server.
+//
+
+void
+brf_metrics_register(
+    pappl_system_t *system)		// I - System
+{
+  papplSystemAddResourceCallback(system, "/metrics", "text/plain", brf_metrics_page, NULL);
+}
+
+
+//
+// 'brf_metrics_ns()' - Return the nanoseconds between two times.
+//
+
+static long long			// O - Nanoseconds
+brf_metrics_ns(
+    const struct timespec *start,	// I - Start time
+    const struct timespec *end)		// I - End time
+{
+  return ((long long)(end->tv_sec - start->tv_sec) * 1000000000LL + (end->tv_nsec - start->tv_nsec));
+}
+
+
+//
+// 'brf_metrics_page()' - Show the aggregate counters.
+//
+
+static bool				// O - `true` on success
+brf_metrics_page(
+    pappl_client_t *client,		// I - Client
+    void           *data)		// I - Callback data (unused)
+{
+  int	i;				// Looping var
+
+
+  (void)data;
+
+  if (!papplClientRespond(client, HTTP_STATUS_OK, NULL, "text/plain", 0, 0))
+    return (false);
+
+  pthread_mutex_lock(&brf_metrics_mutex);
+
+  papplClientPrintf(client, "# Braille Printer Application filter chain metrics\n");
+  papplClientPrintf(client, "brf_jobs_total %lu\n", brf_metrics_jobs);
+
+  for (i = 0; i < brf_metrics_num_totals; i ++)
+  {
+    brf_metrics_total_t *t = brf_metrics_totals + i;
+
+    papplClientPrintf(client, "brf_stage_runs_total{stage=\"%s\"} %lu\n", t->name, t->runs);
+    papplClientPrintf(client, "brf_stage_failures_total{stage=\"%s\"} %lu\n", t->name, t->failures);
+    papplClientPrintf(client, "brf_stage_input_bytes_total{stage=\"%s\"} %llu\n", t->name, t->bytes_in);
+    papplClientPrintf(client, "brf_stage_wall_seconds_total{stage=\"%s\"} %.6f\n", t->name, t->wall);
+    papplClientPrintf(client, "brf_stage_cpu_seconds_total{stage=\"%s\"} %.6f\n", t->name, t->cpu);
+    papplClientPrintf(client, "brf_stage_max_rss_kilobytes{stage=\"%s\"} %ld\n", t->name, t->maxrss_kb);
+  }
+
+  pthread_mutex_unlock(&brf_metrics_mutex);
+
+  return (true);
+}
+
+
+//
+// 'brf_metrics_rchar()' - Return the bytes read by this process and its
+//                         waited-for children.
+//
+
+static unsigned long long		// O - Bytes read or 0 if unknown
+brf_metrics_rchar(void)
+{
+  FILE			*fp;		// /proc/self/io
+  char			line[256];	// Line from file
+  unsigned long long	rchar = 0;	// Bytes read
+
+
+  if ((fp = fopen("/proc/self/io", "r")) == NULL)
+    return (0);
+
+  while (fgets(line, sizeof(line), fp))
+  {
+    if (!strncmp(line, "rchar:", 6))
+    {
+      rchar = strtoull(line + 6, NULL, 10);
+      break;
+    }
+  }
+
+  fclose(fp);
+
+  return (rchar);
+}
+
+
+//
+// 'brf_metrics_stage()' - Run and measure a stage of the chain.
+//
+
+static int				// O - Exit status of the wrapped filter
+brf_metrics_stage(
+    int              inputfd,		// I - Input file descriptor
+    int              outputfd,		// I - Output file descriptor
+    int              inputseekable,	// I - Is the input seekable?
+    cf_filter_data_t *data,		// I - Job and printer data
+    void             *parameters)	// I - Stage
+{
+  brf_stage_t		*stage = (brf_stage_t *)parameters;
+					// Stage
+  brf_stage_stats_t	*stats = stage->stats;
+					// Results
+  struct rusage		self_start,	// Usage of this process at start
+			self_end,	// ... at end
+			children_start,	// Usage of external filters at start
+			children_end;	// ... at end
+  struct timespec	start,		// Start time
+			end;		// End time
+  unsigned long long	rchar = 0;	// Bytes read at start
+  int			status;		// Exit status
+
+
+  memset(stats, 0, sizeof(brf_stage_stats_t));
+
+  stats->forked = getpid() != stage->pid;
+
+  if (stats->forked)
+  {
+    getrusage(RUSAGE_SELF, &self_start);
+    getrusage(RUSAGE_CHILDREN, &children_start);
+    rchar = brf_metrics_rchar();
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  status = (stage->inner->function)(inputfd, outputfd, inputseekable, data, stage->inner->parameters);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  stats->wall_ns = brf_metrics_ns(&start, &end);
+  stats->status  = status;
+
+  if (stats->forked)
+  {
+    getrusage(RUSAGE_SELF, &self_end);
+    getrusage(RUSAGE_CHILDREN, &children_end);
+
+    stats->bytes_in  = brf_metrics_rchar() - rchar;
+    stats->user_us   = (self_end.ru_utime.tv_sec - self_start.ru_utime.tv_sec + children_end.ru_utime.tv_sec - children_start.ru_utime.tv_sec) * 1000000LL + (self_end.ru_utime.tv_usec - self_start.ru_utime.tv_usec + children_end.ru_utime.tv_usec - children_start.ru_utime.tv_usec);
+    stats->sys_us    = (self_end.ru_stime.tv_sec - self_start.ru_stime.tv_sec + children_end.ru_stime.tv_sec - children_start.ru_stime.tv_sec) * 1000000LL + (self_end.ru_stime.tv_usec - self_start.ru_stime.tv_usec + children_end.ru_stime.tv_usec - children_start.ru_stime.tv_usec);
+    stats->maxrss_kb = children_end.ru_maxrss;
+  }
+
+  stats->done = 1;
+
+  return (status);
+}
@@ -0,0 +1,490 @@
+//
+// Content sniffing for the Braille Printer Application
+//
+// Copyright © 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Documents submitted as application/octet-stream are typed from their
+// first few KB: magic numbers are matched with a byte trie that is built
+// once at startup, and text documents are classified with a word-at-a-time
+// scan to tell BRF, UBRL and plain text apart.
+//
+
+//
+// Include necessary headers...
+//
+
+#include <pappl/pappl.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <strings.h>
+#include "brf-printer-app.h"
+
+
+//
+// Constants...
+//
+
+#define BRF_MIME_MAX_NODES	256	// Max trie nodes
+#define BRF_MIME_SNIFF_MAX	4096	// Max bytes to classify
+
+#define BRF_MIME_ONES		UINT64_C(0x0101010101010101)
+#define BRF_MIME_HIGH		UINT64_C(0x8080808080808080)
+
+
+//
+// Local types...
+//
+
+typedef enum brf_mime_container_e	// Containers needing a closer look
+{
+  BRF_MIME_NONE,			// Type is final
+  BRF_MIME_ZIP,				// Zip container (ODF/OOXML)
+  BRF_MIME_XML				// Generic XML document
+} brf_mime_container_t;
+
+typedef struct brf_mime_sig_s		// Header signature
+{
+  const char	*bytes;			// Signature bytes
+  size_t	length;			// Length of signature
+  bool		nocase;			// Match letters case-insensitively?
+  const char	*type;			// MIME media type
+  brf_mime_container_t container;	// Container to look into
+} brf_mime_sig_t;
+
+typedef struct brf_mime_node_s		// Trie node
+{
+  unsigned char	next[256];		// Child node for each byte, 0 if none
+  short		sig;			// Signature ending here or -1
+} brf_mime_node_t;
+
+typedef struct brf_mime_zip_s		// Zip container first-entry names
+{
+  const char	*prefix;		// Entry name prefix
+  const char	*type;			// MIME media type
+} brf_mime_zip_t;
+
+
+//
+// Local functions...
+//
+
+static const char	*brf_mime_text(const unsigned char *header, size_t headersize);
+static const char	*brf_mime_xml(const unsigned char *header, size_t headersize);
+static const char	*brf_mime_zip(const unsigned char *header, size_t headersize);
+static void		brf_mime_init(void);
+static bool		brf_mime_contains(const unsigned char *header, size_t headersize, const char *s);
+
+
+//
+// Local globals...
+//
+
+#define BRF_MIME_SIG(s,nocase,type)	{ s, sizeof(s) - 1, nocase, type, BRF_MIME_NONE }
+#define BRF_MIME_CONTAINER(s,container)	{ s, sizeof(s) - 1, false, NULL, container }
+
+static const brf_mime_sig_t brf_mime_sigs[] =
+{					// Signatures, matched at the start
+  BRF_MIME_SIG("%PDF-",				false, "application/pdf"),
+  BRF_MIME_SIG("\211PNG\r\n\032\n",		false, "image/png"),
+  BRF_MIME_SIG("\377\330\377",			false, "image/jpeg"),
+  BRF_MIME_SIG("II*\0",				false, "image/tiff"),
+  BRF_MIME_SIG("MM\0*",				false, "image/tiff"),
+  BRF_MIME_SIG("GIF87a",			false, "image/gif"),
+  BRF_MIME_SIG("GIF89a",			false, "image/gif"),
+  BRF_MIME_CONTAINER("PK\003\004",		BRF_MIME_ZIP),
+  BRF_MIME_SIG("\320\317\021\340\241\261\032\341",
+						false, "application/msword"),
+  BRF_MIME_SIG("{\\rtf",			false, "text/rtf"),
+  BRF_MIME_CONTAINER("<?xml",			BRF_MIME_XML),
+  BRF_MIME_SIG("<!doctype html",		true,  "text/html"),
+  BRF_MIME_SIG("<html",				true,  "text/html"),
+  BRF_MIME_SIG("<head",				true,  "text/html"),
+  BRF_MIME_SIG("<!doctype score-partwise",	true,  "application/vnd.recordare.musicxml+xml"),
+  BRF_MIME_SIG("<score-partwise",		false, "application/vnd.recordare.musicxml+xml")
+};
+#define BRF_MIME_NUM_SIGS	(int)(sizeof(brf_mime_sigs) / sizeof(brf_mime_sigs[0]))
+
+static const char * const brf_mime_odf[] =
+{					// OpenDocument types (from braille.types)
+  "application/vnd.oasis.opendocument.chart",
+  "application/vnd.oasis.opendocument.database",
+  "application/vnd.oasis.opendocument.formula",
+  "application/vnd.oasis.opendocument.graphics",
+  "application/vnd.oasis.opendocument.graphics-template",
+  "application/vnd.oasis.opendocument.image",
+  "application/vnd.oasis.opendocument.presentation",
+  "application/vnd.oasis.opendocument.presentation-template",
+  "application/vnd.oasis.opendocument.spreadsheet",
+  "application/vnd.oasis.opendocument.spreadsheet-template",
+  "application/vnd.oasis.opendocument.text",
+  "application/vnd.oasis.opendocument.text-master",
+  "application/vnd.oasis.opendocument.text-template",
+  "application/vnd.oasis.opendocument.text-web"
+};
+
+static const brf_mime_zip_t brf_mime_ooxml[] =
+{					// Office Open XML part names
+  { "word/",	"application/vnd.openxmlformats-officedocument.wordprocessingml.document" },
+  { "xl/",	"application/vnd.openxmlformats-officedocument.spreadsheetml.sheet" },
+  { "ppt/",	"application/vnd.openxmlformats-officedocument.presentationml.presentation" }
+};
+
+static brf_mime_node_t	brf_mime_nodes[BRF_MIME_MAX_NODES];
+					// Signature trie, node 0 is the root
+static int		brf_mime_num_nodes = 1;
+					// Number of trie nodes in use
+static pthread_once_t	brf_mime_once = PTHREAD_ONCE_INIT;
+					// Initialization control
+
+
+//
+// 'brf_mime_type()' - Determine the MIME media type of a document header.
+//
+
+const char *				// O - MIME media type or `NULL` if unknown
+brf_mime_type(
+    const unsigned char *header,	// I - Header data
+    size_t              headersize)	// I - Size of header data
+{
+  const unsigned char	*ptr,		// Pointer into header
+			*end;		// End of header
+  const brf_mime_node_t	*node;		// Current trie node
+  int			sig = -1;	// Longest matching signature
+
+
+  pthread_once(&brf_mime_once, brf_mime_init);
+
+  if (!header || headersize == 0)
+    return (NULL);
+
+  // Skip a UTF-8 byte order mark and leading whitespace so that markup with
+  // a preamble still matches; binary signatures never start with either...
+  ptr = header;
+  end = header + headersize;
+
+  if (headersize >= 3 && !memcmp(ptr, "\357\273\277", 3))
+    ptr += 3;
+
+  while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == '\r' || *ptr == '\n'))
+    ptr ++;
+
+  // Walk the trie, remembering the longest signature seen...
+  for (node = brf_mime_nodes; ptr < end && node->next[*ptr]; ptr ++)
+  {
+    node = brf_mime_nodes + node->next[*ptr];
+    if (node->sig >= 0)
+      sig = node->sig;
+  }
+
+  if (sig >= 0)
+  {
+    switch (brf_mime_sigs[sig].container)
+    {
+      case BRF_MIME_ZIP :
+          return (brf_mime_zip(header, headersize));
+      case BRF_MIME_XML :
+          return (brf_mime_xml(header, headersize));
+      default :
+          return (brf_mime_sigs[sig].type);
+    }
+  }
+
+  // No magic number, check for braille or plain text...
+  return (brf_mime_text(header, headersize));
+}
+
+
+//
+// 'brf_mime_contains()' - Search the header for a string, ignoring case.
+//
+
+static bool				// O - `true` if found
+brf_mime_contains(
+    const unsigned char *header,	// I - Header data
+    size_t              headersize,	// I - Size of header data
+    const char          *s)		// I - Lowercase string to find
+{
+  size_t	i,			// Looping var
+		len = strlen(s);	// Length of string
+
+
+  for (i = 0; i + len <= headersize; i ++)
+  {
+    if (tolower(header[i]) == s[0] && !strncasecmp((const char *)header + i, s, len))
+      return (true);
+  }
+
+  return (false);
+}
+
+
+//
+// 'brf_mime_init()' - Build the signature trie.
+//
+
+static void
+brf_mime_init(void)
+{
+  int			i;		// Looping var
+  size_t		j;		// Looping var
+  brf_mime_node_t	*node;		// Current node
+  int			c,		// Current byte
+			alt,		// Other case of current byte
+			next;		// Next node
+
+
+  for (i = 0; i < BRF_MIME_MAX_NODES; i ++)
+    brf_mime_nodes[i].sig = -1;
+
+  for (i = 0; i < BRF_MIME_NUM_SIGS; i ++)
+  {
+    node = brf_mime_nodes;
+
+    for (j = 0; j < brf_mime_sigs[i].length; j ++)
+    {
+      c   = brf_mime_sigs[i].bytes[j] & 255;
+      alt = brf_mime_sigs[i].nocase ? toupper(c) : c;
+
+      if ((next = node->next[c]) == 0)
+      {
+        if (brf_mime_num_nodes >= BRF_MIME_MAX_NODES)
+          return;
+
+        next          = brf_mime_num_nodes ++;
+        node->next[c] = (unsigned char)next;
+      }
+
+      // Case-insensitive signatures share the node for both cases...
+      node->next[alt] = (unsigned char)next;
+      node            = brf_mime_nodes + next;
+    }
+
+    node->sig = (short)i;
+  }
+}
+
+
+//
+// 'brf_mime_text()' - Classify a text header as BRF, UBRL or plain text.
+//
+// Pure ASCII runs are checked 8 bytes at a time: each test below computes a
+// per-byte flag in the high bit of every byte without carries between bytes,
+// so only words holding control or non-ASCII bytes are looked at one byte at
+// a time.  BRF is printable ASCII plus CR/LF/FF with uppercase letters only,
+// and since plain uppercase text looks the same it also needs form feeds or
+// characters which are rare in text but common in BRF (#, @, [, \, ], ^
+// and _); it is typed as application/vnd.cups-brf, paged or not.  UBRL is
+// UTF-8 braille patterns (U+2800 to U+28FF) with the same whitespace.
+//
+
+static const char *			// O - MIME media type or `NULL` if binary
+brf_mime_text(
+    const unsigned char *header,	// I - Header data
+    size_t              headersize)	// I - Size of header data
+{
+  const unsigned char	*ptr,		// Pointer into header
+			*end;		// End of header
+  uint64_t		w,		// Current word
+			ctrl,		// Control byte flags
+			upper = 0,	// Uppercase letters seen
+			lower = 0,	// Lowercase letters seen
+			punct = 0;	// BRF punctuation seen
+  bool			ascii_only = true,
+					// Only ASCII bytes seen?
+			brf_ok = true,	// Only BRF whitespace seen?
+			have_ff = false,// Any form feeds seen?
+			ubrl_ok = true,	// Only braille patterns seen?
+			have_ubrl = false;
+					// Any braille patterns seen?
+  int			i;		// Looping var
+
+
+  if (headersize > BRF_MIME_SNIFF_MAX)
+    headersize = BRF_MIME_SNIFF_MAX;
+
+  ptr = header;
+  end = header + headersize;
+
+  while (ptr < end)
+  {
+    if (end - ptr >= 8)
+    {
+      memcpy(&w, ptr, sizeof(w));
+
+      if (!(w & BRF_MIME_HIGH))
+      {
+        // All ASCII: flag control bytes (< 0x20 or 0x7f)...
+        ctrl = (~(w + 0x60 * BRF_MIME_ONES) | (w + BRF_MIME_ONES)) & BRF_MIME_HIGH;
+
+        if (!ctrl)
+        {
+          // Only printable ASCII, which is fine for BRF but can only be
+          // spaces in UBRL; collect A-Z and a-z for the case check...
+          upper |= (w + 0x3f * BRF_MIME_ONES) & ~(w + 0x25 * BRF_MIME_ONES) & BRF_MIME_HIGH;
+          lower |= (w + 0x1f * BRF_MIME_ONES) & ~(w + 0x05 * BRF_MIME_ONES) & BRF_MIME_HIGH;
+          punct |= (((w + 0x5d * BRF_MIME_ONES) & ~(w + 0x5c * BRF_MIME_ONES)) |
+                    ((w + 0x40 * BRF_MIME_ONES) & ~(w + 0x3f * BRF_MIME_ONES)) |
+                    ((w + 0x25 * BRF_MIME_ONES) & ~(w + 0x20 * BRF_MIME_ONES))) & BRF_MIME_HIGH;
+
+          if (w != 0x20 * BRF_MIME_ONES)
+            ubrl_ok = false;
+
+          ptr += 8;
+          continue;
+        }
+      }
+    }
+
+    // Slow path for control and non-ASCII bytes...
+    if (*ptr < 0x80)
+    {
+      if (*ptr == '\f')
+        have_ff = true;
+      else if (*ptr == '\r' || *ptr == '\n')
+        ;
+      else if (*ptr == '\t' || *ptr == 0x1a)
+        brf_ok = ubrl_ok = false;
+      else if (*ptr < ' ' || *ptr == 0x7f)
+        return (NULL);
+      else
+      {
+        if (*ptr != ' ')
+          ubrl_ok = false;
+        if (*ptr >= 'A' && *ptr <= 'Z')
+          upper = 1;
+        else if (*ptr >= 'a' && *ptr <= 'z')
+          lower = 1;
+        else if (*ptr == '#' || *ptr == '@' || (*ptr >= '[' && *ptr <= '_'))
+          punct = 1;
+      }
+
+      ptr ++;
+      continue;
+    }
+
+    ascii_only = false;
+
+    if (*ptr == 0xe2 && end - ptr >= 3 && (ptr[1] & 0xfc) == 0xa0 && (ptr[2] & 0xc0) == 0x80)
+    {
+      // U+2800 to U+28FF
+      have_ubrl = true;
+      ptr       += 3;
+    }
+    else if (*ptr >= 0xc2 && *ptr <= 0xf4)
+    {
+      // Other UTF-8 sequence, allow one to be cut at the end of the header...
+      int len = *ptr >= 0xf0 ? 4 : *ptr >= 0xe0 ? 3 : 2;
+
+      for (i = 1; i < len && ptr + i < end; i ++)
+        if ((ptr[i] & 0xc0) != 0x80)
+          return (NULL);
+
+      ubrl_ok = false;
+      ptr     += len;
+    }
+    else
+      return (NULL);
+  }
+
+  if (ascii_only)
+  {
+    if (brf_ok && upper && !lower && (have_ff || punct))
+      return ("application/vnd.cups-brf");
+    else
+      return ("text/plain");
+  }
+  else if (have_ubrl && ubrl_ok)
+    return ("application/vnd.cups-paged-ubrl");
+  else
+    return ("text/plain");
+}
+
+
+//
+// 'brf_mime_xml()' - Determine the type of an XML document.
+//
+
+static const char *			// O - MIME media type
+brf_mime_xml(
+    const unsigned char *header,	// I - Header data
+    size_t              headersize)	// I - Size of header data
+{
+  if (brf_mime_contains(header, headersize, "<score-partwise") || brf_mime_contains(header, headersize, "<score-timewise"))
+    return ("application/vnd.recordare.musicxml+xml");
+  else if (brf_mime_contains(header, headersize, "<html"))
+    return ("text/html");
+  else
+    return ("application/xml");
+}
+
+
+//
+// 'brf_mime_zip()' - Determine the type of a zip container.
+//
+// OpenDocument files start with an uncompressed "mimetype" entry holding the
+// media type.  Office Open XML files are recognized by the names of the
+// local file headers found in the header data.
+//
+
+static const char *			// O - MIME media type or `NULL` if unknown
+brf_mime_zip(
+    const unsigned char *header,	// I - Header data
+    size_t              headersize)	// I - Size of header data
+{
+  size_t	offset = 0,		// Offset of local file header
+		namelen,		// Length of entry name
+		extralen,		// Length of extra field
+		datalen;		// Length of compressed data
+  const char	*name;			// Entry name
+  size_t	i;			// Looping var
+
+
+  while (offset + 30 <= headersize && !memcmp(header + offset, "PK\003\004", 4))
+  {
+    namelen  = header[offset + 26] | (header[offset + 27] << 8);
+    extralen = header[offset + 28] | (header[offset + 29] << 8);
+    datalen  = header[offset + 18] | (header[offset + 19] << 8) | ((size_t)header[offset + 20] << 16) | ((size_t)header[offset + 21] << 24);
+    name     = (const char *)header + offset + 30;
+
+    if (offset + 30 + namelen > headersize)
+      break;
+
+    if (offset == 0 && namelen == 8 && !memcmp(name, "mimetype", 8) && !header[8] && !header[9])
+    {
+      // Stored mimetype entry...
+      const char *data = name + namelen + extralen;
+
+      if (offset + 30 + namelen + extralen + datalen > headersize)
+        break;
+
+      for (i = 0; i < sizeof(brf_mime_odf) / sizeof(brf_mime_odf[0]); i ++)
+      {
+        if (strlen(brf_mime_odf[i]) == datalen && !memcmp(data, brf_mime_odf[i], datalen))
+          return (brf_mime_odf[i]);
+      }
+
+      return (NULL);
+    }
+
+    for (i = 0; i < sizeof(brf_mime_ooxml) / sizeof(brf_mime_ooxml[0]); i ++)
+    {
+      size_t len = strlen(brf_mime_ooxml[i].prefix);
+
+      if (namelen > len && !memcmp(name, brf_mime_ooxml[i].prefix, len))
+        return (brf_mime_ooxml[i].type);
+    }
+
+    // Sizes are in a trailing data descriptor when bit 3 is set, so the next
+    // header cannot be located...
+    if (header[offset + 6] & 0x08)
+      break;
+
+    offset += 30 + namelen + extralen + datalen;
+  }
+
+  return (NULL);
+}
@@ -0,0 +1,686 @@
+//
+// Embosser pools for the Braille Printer Application
+//
+// Copyright © 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// A pool is a printer whose device URI is "pool:///" followed by the names
+// of its member printers, comma-separated ("pool:///Index%201,Index%202"),
+// or nothing for all other printers using the same driver as the pool.
+// "?pages=N" sets the number of pages per range.
+//
+// A job sent to a pool is split at form feeds into ranges of contiguous
+// pages, the pages brftopagedbrf counts, and the ranges are sent as they are
+// to the members which are idle, so the document is only translated once.
+// Each member starts with an equal share of the ranges, in order; a member
+// which runs out of ranges steals the last range of the member with the most
+// ranges left, so that a busy or slow member does not hold up the job.
+//
+
+//
+// Include necessary headers...
+//
+
+#include <pappl/pappl.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "brf-printer-app.h"
+
+
+//
+// Constants...
+//
+
+#define BRF_POOL_MAX_MEMBERS	16	// Max members in a pool
+#define BRF_POOL_RANGES		4	// Ranges per member by default
+#define BRF_POOL_MIN_PAGES	10	// Min pages per range by default
+#define BRF_POOL_RETRY		2	// Seconds between tries of a busy member
+
+
+//
+// Local types...
+//
+
+typedef struct brf_pool_range_s		// Range of pages
+{
+  int			first,		// First page
+			last;		// Last page
+  off_t			offset,		// Offset in the document
+			length;		// Length in bytes
+} brf_pool_range_t;
+
+typedef struct brf_pool_member_s	// Member embosser
+{
+  struct brf_pool_job_s	*pj;		// Pool job
+  pappl_printer_t	*printer;	// Member printer
+  pthread_t		tid;		// Thread sending the ranges
+  int			head,		// First range left
+			tail;		// Last range left + 1
+} brf_pool_member_t;
+
+typedef struct brf_pool_job_s		// Pool job
+{
+  pappl_job_t		*job;		// Job
+  pappl_pr_options_t	*options;	// Job options
+  pappl_printer_t	*printer;	// Pool printer
+  const char		*driver_name;	// Driver of the pool
+  char			names[1024];	// Member names, comma-separated
+  int			fd;		// Document
+  int			num_ranges;	// Number of ranges
+  brf_pool_range_t	*ranges;	// Ranges
+  int			num_members;	// Number of members
+  brf_pool_member_t	members[BRF_POOL_MAX_MEMBERS];
+					// Members
+  int			pages,		// Pages to emboss
+			completed;	// Pages embossed
+  bool			failed;		// Did a range fail?
+  pthread_mutex_t	mutex;		// Mutex for the ranges and counts
+} brf_pool_job_t;
+
+
+//
+// Local functions...
+//
+
+static void	brf_pool_add(pappl_printer_t *printer, void *data);
+static void	brf_pool_close_cb(pappl_device_t *device);
+static bool	brf_pool_list_cb(pappl_device_cb_t cb, void *data, pappl_deverror_cb_t err_cb, void *err_data);
+static bool	brf_pool_open_cb(pappl_device_t *device, const char *device_uri, const char *name);
+static ssize_t	brf_pool_read_cb(pappl_device_t *device, void *buffer, size_t bytes);
+static void	*brf_pool_run(void *data);
+static bool	brf_pool_send(brf_pool_job_t *pj, pappl_device_t *device, brf_pool_range_t *range);
+static int	brf_pool_split(brf_pool_job_t *pj, int first_page, int last_page, int range_pages);
+static pappl_preason_t brf_pool_status_cb(pappl_device_t *device);
+static int	brf_pool_take(brf_pool_job_t *pj, brf_pool_member_t *m);
+static ssize_t	brf_pool_write_cb(pappl_device_t *device, const void *buffer, size_t bytes);
+
+
+//
+// 'brf_pool_print()' - Emboss a BRF document on the members of a pool.
+//
+// The document must be a regular file.  When "page_ranges" is set the
+// page-ranges of the job are selected here, otherwise they have already
+// been applied by the filters.
+//
+
+bool					// O - `true` on success, `false` on failure
+brf_pool_print(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    int                fd,		// I - Document
+    bool               page_ranges)	// I - Select the job's page ranges?
+{
+  brf_pool_job_t	*pj;		// Pool job
+  brf_pool_member_t	*m;		// Current member
+  char			scheme[32],	// URI scheme
+			userpass[256],	// URI username:password
+			host[256],	// URI host
+			resource[1024],	// URI resource
+			*query;		// Query in resource
+  int			port,		// URI port
+			i,		// Looping var
+			range_pages = 0,// Pages per range
+			first_page = 1,	// First page to emboss
+			last_page = INT_MAX,
+					// Last page to emboss
+			error;		// Thread creation error
+  bool			ret;		// Return value
+
+
+  if ((pj = (brf_pool_job_t *)calloc(1, sizeof(brf_pool_job_t))) == NULL)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate memory for pool job: %s", strerror(errno));
+    return (false);
+  }
+
+  pj->job         = job;
+  pj->options     = options;
+  pj->printer     = papplJobGetPrinter(job);
+  pj->driver_name = papplPrinterGetDriverName(pj->printer);
+  pj->fd          = fd;
+
+  // Members and range size from the device URI...
+  if (httpSeparateURI(HTTP_URI_CODING_ALL, papplPrinterGetDeviceURI(pj->printer), scheme, sizeof(scheme), userpass, sizeof(userpass), host, sizeof(host), &port, resource, sizeof(resource)) >= HTTP_URI_STATUS_OK)
+  {
+    if ((query = strchr(resource, '?')) != NULL)
+    {
+      *query++ = '\0';
+      if (!strncmp(query, "pages=", 6))
+        range_pages = atoi(query + 6);
+    }
+
+    papplCopyString(pj->names, resource[0] == '/' ? resource + 1 : resource, sizeof(pj->names));
+  }
+
+  papplSystemIteratePrinters(papplPrinterGetSystem(pj->printer), brf_pool_add, pj);
+
+  if (pj->num_members == 0)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "No embosser in the pool.");
+    free(pj);
+    return (false);
+  }
+
+  // Pages to emboss...
+  if (page_ranges)
+  {
+    if (options->first_page > 1)
+      first_page = options->first_page;
+    if (options->last_page > 0)
+      last_page = options->last_page;
+  }
+
+  if (brf_pool_split(pj, first_page, last_page, range_pages))
+  {
+    free(pj->ranges);
+    free(pj);
+    return (false);
+  }
+
+  papplJobSetImpressions(job, pj->pages > 0 ? pj->pages : 1);
+
+  if (pj->num_ranges == 0)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_INFO, "Nothing to emboss.");
+    free(pj->ranges);
+    free(pj);
+    return (true);
+  }
+
+  papplLogJob(job, PAPPL_LOGLEVEL_INFO, "Embossing %d pages in %d ranges on %d embossers.", pj->pages, pj->num_ranges, pj->num_members);
+
+  // Give each member its share and start sending...
+  pthread_mutex_init(&pj->mutex, NULL);
+
+  for (i = 0, m = pj->members; i < pj->num_members; i ++, m ++)
+  {
+    m->pj   = pj;
+    m->head = pj->num_ranges * i / pj->num_members;
+    m->tail = pj->num_ranges * (i + 1) / pj->num_members;
+  }
+
+  for (i = 0, m = pj->members; i < pj->num_members; i ++, m ++)
+  {
+    if ((error = pthread_create(&m->tid, NULL, brf_pool_run, m)) != 0)
+    {
+      // The others steal the ranges of this member
+      papplLogJob(job, PAPPL_LOGLEVEL_WARN, "Unable to start thread for '%s': %s", papplPrinterGetName(m->printer), strerror(error));
+      m->printer = NULL;
+    }
+  }
+
+  for (i = 0, m = pj->members; i < pj->num_members; i ++, m ++)
+  {
+    if (m->printer)
+      pthread_join(m->tid, NULL);
+  }
+
+  pthread_mutex_destroy(&pj->mutex);
+
+  ret = !pj->failed && pj->completed == pj->pages && !papplJobIsCanceled(job);
+
+  if (ret)
+    papplJobSetImpressionsCompleted(job, pj->pages);
+  else if (!pj->failed && !papplJobIsCanceled(job))
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Only %d of %d pages embossed.", pj->completed, pj->pages);
+
+  free(pj->ranges);
+  free(pj);
+
+  return (ret);
+}
+
+
+//
+// 'brf_pool_printer()' - Is a printer an embosser pool?
+//
+
+bool					// O - `true` for a pool
+brf_pool_printer(
+    pappl_printer_t *printer)		// I - Printer
+{
+  const char	*uri = papplPrinterGetDeviceURI(printer);
+					// Device URI
+
+
+  return (uri && !strncmp(uri, "pool:", 5));
+}
+
+
+//
+// 'brf_pool_register()' - Register the "pool" device scheme.
+//
+
+void
+brf_pool_register(void)
+{
+  papplDeviceAddScheme("pool", PAPPL_DEVTYPE_CUSTOM_LOCAL, brf_pool_list_cb, brf_pool_open_cb, brf_pool_close_cb, brf_pool_read_cb, brf_pool_write_cb, brf_pool_status_cb, NULL);
+}
+
+
+//
+// 'brf_pool_add()' - Add a printer to the members of a pool job.
+//
+
+static void
+brf_pool_add(
+    pappl_printer_t *printer,		// I - Printer
+    void            *data)		// I - Pool job
+{
+  brf_pool_job_t	*pj = (brf_pool_job_t *)data;
+					// Pool job
+  const char		*name = papplPrinterGetName(printer),
+					// Printer name
+			*ptr;		// Pointer into member names
+  size_t		len = strlen(name);
+					// Length of name
+
+
+  if (printer == pj->printer || brf_pool_printer(printer) || pj->num_members >= BRF_POOL_MAX_MEMBERS)
+    return;
+
+  if (pj->names[0])
+  {
+    // Only the listed printers...
+    for (ptr = pj->names; ptr; ptr = strchr(ptr, ','))
+    {
+      if (*ptr == ',')
+        ptr ++;
+      if (!strncmp(ptr, name, len) && (ptr[len] == ',' || !ptr[len]))
+        break;
+    }
+
+    if (!ptr)
+      return;
+
+    if (strcmp(papplPrinterGetDriverName(printer), pj->driver_name))
+    {
+      papplLogJob(pj->job, PAPPL_LOGLEVEL_WARN, "Not using '%s', it does not use the driver of the pool.", name);
+      return;
+    }
+  }
+  else if (strcmp(papplPrinterGetDriverName(printer), pj->driver_name))
+  {
+    // ... or all printers with the same driver
+    return;
+  }
+
+  pj->members[pj->num_members ++].printer = printer;
+}
+
+
+//
+// 'brf_pool_close_cb()' - Close a pool device.
+//
+
+static void
+brf_pool_close_cb(
+    pappl_device_t *device)		// I - Device
+{
+  (void)device;
+}
+
+
+//
+// 'brf_pool_list_cb()' - List the pool device.
+//
+
+static bool				// O - `true` to stop listing
+brf_pool_list_cb(
+    pappl_device_cb_t   cb,		// I - Device callback
+    void                *data,		// I - Callback data
+    pappl_deverror_cb_t err_cb,		// I - Error callback (unused)
+    void                *err_data)	// I - Error callback data (unused)
+{
+  (void)err_cb;
+  (void)err_data;
+
+  return ((cb)("Embosser pool (all printers with the same driver)", "pool:///", "", data));
+}
+
+
+//
+// 'brf_pool_open_cb()' - Open a pool device.
+//
+// Nothing is sent to the pool device itself, the jobs go to its members.
+//
+
+static bool				// O - `true` on success
+brf_pool_open_cb(
+    pappl_device_t *device,		// I - Device
+    const char     *device_uri,		// I - Device URI
+    const char     *name)		// I - Job name
+{
+  (void)device;
+  (void)device_uri;
+  (void)name;
+
+  return (true);
+}
+
+
+//
+// 'brf_pool_read_cb()' - Read from a pool device.
+//
+
+static ssize_t				// O - Bytes read
+brf_pool_read_cb(
+    pappl_device_t *device,		// I - Device
+    void           *buffer,		// I - Buffer
+    size_t         bytes)		// I - Size of buffer
+{
+  (void)device;
+  (void)buffer;
+  (void)bytes;
+
+  return (0);
+}
+
+
+//
+// 'brf_pool_run()' - Send ranges to a member until none are left.
+//
+
+static void *				// O - Thread exit status (unused)
+brf_pool_run(void *data)		// I - Member
+{
+  brf_pool_member_t	*m = (brf_pool_member_t *)data;
+					// Member
+  brf_pool_job_t	*pj = m->pj;	// Pool job
+  const char		*name = papplPrinterGetName(m->printer);
+					// Member name
+  pappl_device_t	*device = NULL;	// Member device
+  brf_pool_range_t	*range;		// Current range
+  int			r;		// Range index
+  bool			ok;		// Was the range sent?
+
+
+  while (!papplJobIsCanceled(pj->job))
+  {
+    pthread_mutex_lock(&pj->mutex);
+    r = pj->failed ? -1 : device ? brf_pool_take(pj, m) : pj->completed < pj->pages ? 0 : -1;
+    pthread_mutex_unlock(&pj->mutex);
+
+    if (r < 0)
+      break;
+
+    if (!device)
+    {
+      // Only use the member while it is idle, its own jobs come first
+      if ((device = papplPrinterOpenDevice(m->printer)) == NULL)
+      {
+        sleep(BRF_POOL_RETRY);
+        continue;
+      }
+
+      papplLogJob(pj->job, PAPPL_LOGLEVEL_DEBUG, "Using '%s'.", name);
+      continue;
+    }
+
+    range = pj->ranges + r;
+
+    papplLogJob(pj->job, PAPPL_LOGLEVEL_INFO, "Embossing pages %d-%d on '%s'.", range->first, range->last, name);
+
+    ok = brf_pool_send(pj, device, range);
+
+    pthread_mutex_lock(&pj->mutex);
+    if (ok)
+    {
+      pj->completed += range->last - range->first + 1;
+      papplJobSetImpressionsCompleted(pj->job, pj->completed);
+      papplJobSetMessage(pj->job, "%d of %d pages embossed.", pj->completed, pj->pages);
+    }
+    else
+    {
+      papplLogJob(pj->job, PAPPL_LOGLEVEL_ERROR, "Unable to emboss pages %d-%d on '%s'.", range->first, range->last, name);
+      pj->failed = true;
+    }
+    pthread_mutex_unlock(&pj->mutex);
+  }
+
+  if (device)
+    papplPrinterCloseDevice(m->printer);
+
+  return (NULL);
+}
+
+
+//
+// 'brf_pool_send()' - Send a range of pages to a member.
+//
+
+static bool				// O - `true` on success, `false` on failure
+brf_pool_send(
+    brf_pool_job_t   *pj,		// I - Pool job
+    pappl_device_t   *device,		// I - Member device
+    brf_pool_range_t *range)		// I - Range
+{
+  char		buffer[65536];		// Copy buffer
+  off_t		offset = range->offset,	// Current offset
+		end = range->offset + range->length;
+					// End of range
+  ssize_t	bytes;			// Bytes read
+  bool		ret = true;		// Return value
+
+
+  if (!strncmp(pj->driver_name, "indexv", 6))
+  {
+    // Index embossers need the BRF to be encoded in transparent mode
+    ret = brf_index_print_part(pj->job, pj->options, device, pj->fd, range->offset, range->length);
+  }
+  else
+  {
+    while (offset < end && (bytes = pread(pj->fd, buffer, end - offset < (off_t)sizeof(buffer) ? (size_t)(end - offset) : sizeof(buffer), offset)) > 0)
+    {
+      if (papplDeviceWrite(device, buffer, (size_t)bytes) < 0)
+      {
+        ret = false;
+        break;
+      }
+
+      offset += bytes;
+    }
+
+    if (offset < end)
+      ret = false;
+  }
+
+  papplDeviceFlush(device);
+
+  return (ret);
+}
+
+
+//
+// 'brf_pool_split()' - Split the document into ranges of pages.
+//
+// Pages end with a form feed like in brftopagedbrf, text after the last one
+// is one more page unless it only has line ends.
+//
+
+static int				// O - 0 on success, -1 on error
+brf_pool_split(
+    brf_pool_job_t *pj,			// I - Pool job
+    int            first_page,		// I - First page to emboss
+    int            last_page,		// I - Last page to emboss
+    int            range_pages)		// I - Pages per range or 0 for auto
+{
+  unsigned char	buffer[65536],		// Read buffer
+		*ptr,			// Pointer into buffer
+		*end;			// End of buffer
+  ssize_t	bytes;			// Bytes read
+  off_t		offset = 0,		// Offset of buffer
+		*starts = NULL,		// Start offset of each page + end
+		*temp;			// New starts array
+  int		num_pages = 0,		// Number of pages
+		alloc_pages = 0,	// Allocated pages
+		base,			// First page of the first sheet
+		page,			// Current page
+		i;			// Looping var
+  bool		content = false;	// Text after the last form feed?
+  brf_pool_range_t *range;		// Current range
+
+
+  for (;;)
+  {
+    if ((bytes = pread(pj->fd, buffer, sizeof(buffer), offset)) < 0)
+    {
+      papplLogJob(pj->job, PAPPL_LOGLEVEL_ERROR, "Unable to read print file: %s", strerror(errno));
+      free(starts);
+      return (-1);
+    }
+
+    for (ptr = buffer, end = buffer + bytes; ptr <= end; ptr ++)
+    {
+      if (ptr < end && *ptr != '\f')
+      {
+        if (*ptr != '\n' && *ptr != '\r')
+          content = true;
+        continue;
+      }
+
+      if (ptr == end && (bytes > 0 || !content))
+        break;
+
+      // Start of the first page, then end of each page
+      if (num_pages + 2 > alloc_pages)
+      {
+        alloc_pages += 1024;
+        if ((temp = (off_t *)realloc(starts, (size_t)alloc_pages * sizeof(off_t))) == NULL)
+        {
+          papplLogJob(pj->job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate memory for pages: %s", strerror(errno));
+          free(starts);
+          return (-1);
+        }
+        starts = temp;
+      }
+
+      starts[0]               = 0;
+      starts[++ num_pages]    = offset + (ptr - buffer) + (ptr < end);
+      content                 = false;
+    }
+
+    if (bytes == 0)
+      break;
+
+    offset += bytes;
+  }
+
+  // Pages selected...
+  if (last_page > num_pages)
+    last_page = num_pages;
+
+  pj->pages = last_page >= first_page ? last_page - first_page + 1 : 0;
+
+  if (pj->pages == 0)
+  {
+    free(starts);
+    return (0);
+  }
+
+  // Ranges of an even number of pages starting on odd pages, so that no
+  // sheet of the document gets split when embossing double-sided; only the
+  // first range starts on an even page when the page ranges of the job do
+  if (range_pages <= 0)
+  {
+    range_pages = (pj->pages + pj->num_members * BRF_POOL_RANGES - 1) / (pj->num_members * BRF_POOL_RANGES);
+    if (range_pages < BRF_POOL_MIN_PAGES)
+      range_pages = BRF_POOL_MIN_PAGES;
+  }
+
+  range_pages += range_pages & 1;
+
+  base           = first_page - !(first_page & 1);
+  pj->num_ranges = (last_page - base + range_pages) / range_pages;
+
+  if ((pj->ranges = (brf_pool_range_t *)calloc((size_t)pj->num_ranges, sizeof(brf_pool_range_t))) == NULL)
+  {
+    papplLogJob(pj->job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate memory for ranges: %s", strerror(errno));
+    free(starts);
+    return (-1);
+  }
+
+  for (i = 0, page = base, range = pj->ranges; i < pj->num_ranges; i ++, page += range_pages, range ++)
+  {
+    range->first  = page < first_page ? first_page : page;
+    range->last   = page + range_pages - 1 > last_page ? last_page : page + range_pages - 1;
+    range->offset = starts[range->first - 1];
+    range->length = starts[range->last] - range->offset;
+  }
+
+  free(starts);
+
+  return (0);
+}
+
+
+//
+// 'brf_pool_status_cb()' - Get the status of a pool device.
+//
+
+static pappl_preason_t			// O - Printer state reasons
+brf_pool_status_cb(
+    pappl_device_t *device)		// I - Device
+{
+  (void)device;
+
+  return (PAPPL_PREASON_NONE);
+}
+
+
+//
+// 'brf_pool_take()' - Take the next range for a member.
+//
+// Called with the pool job mutex held.
+//
+
+static int				// O - Range index or -1 if none is left
+brf_pool_take(
+    brf_pool_job_t    *pj,		// I - Pool job
+    brf_pool_member_t *m)		// I - Member
+{
+  brf_pool_member_t	*victim = NULL,	// Member to steal from
+			*other;		// Other member
+  int			i;		// Looping var
+
+
+  // Own ranges first, in order...
+  if (m->head < m->tail)
+    return (m->head ++);
+
+  // ... then the last range of the member with the most ranges left
+  for (i = 0, other = pj->members; i < pj->num_members; i ++, other ++)
+  {
+    if (other->tail - other->head > 0 && (!victim || other->tail - other->head > victim->tail - victim->head))
+      victim = other;
+  }
+
+  if (!victim)
+    return (-1);
+
+  return (-- victim->tail);
+}
+
+
+//
+// 'brf_pool_write_cb()' - Write to a pool device.
+//
+
+static ssize_t				// O - Bytes written or -1 on error
+brf_pool_write_cb(
+    pappl_device_t *device,		// I - Device
+    const void     *buffer,		// I - Buffer
+    size_t         bytes)		// I - Bytes to write
+{
+  (void)buffer;
+  (void)bytes;
+
+  // Only BRF documents are split among the members
+  papplDeviceError(device, "Only braille text can be sent to an embosser pool.");
+
+  return (-1);
+}
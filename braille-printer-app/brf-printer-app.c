@@ -8,7 +8,9 @@
 #include <cupsfilters/log.h>
 #include <cupsfilters/filter.h>
 #include <limits.h>
+#include <pthread.h>
 #include <pappl/pappl.h>
+#include "brf-printer-app.h"
 
 
 
@@ -17,9 +19,6 @@
 #  define brf_TESTPAGE_MIMETYPE	"application/vnd.cups-paged-brf"
 
 
-extern bool	brf_gen(pappl_system_t *system, const char *driver_name, const char *device_uri, const char *device_id, pappl_pr_driver_data_t *data, ipp_t **attrs, void *cbdata);
-extern char* strdup(const char*);
-
 //
 // 'brfCreateJobData()' - Load the printer's PPD file and set the PPD options
 //                          according to the job options
@@ -72,8 +71,23 @@ typedef struct brf_printer_app_global_data_s
 
 } brf_printer_app_global_data_t;
 
+// Data for brf_print_filter_function()
+typedef struct brf_print_filter_function_data_s
+// look-up table
+{
+  pappl_device_t *device;                    // Device
+  const char *device_uri;                          // Printer device URI
+  pappl_job_t *job;                          // Job
+  brf_printer_app_global_data_t *global_data; // Global data
+} brf_print_filter_function_data_t;
+
+#define BRF_MAX_FILTERS		4	// Max filters in a spooling conversion
+#define BRF_MAX_ENV		3	// Max per-job environment entries
+
 typedef struct brf_job_data_s		// Job data
 {
+  brf_arena_t           *arena;         // Memory for everything below, the
+                                        // job data itself included
   char                  *device_uri;    // Printer device URI
                                           // PPD file to be used by CUPS filters
   cf_filter_data_t         *filter_data;   // Common print job data for filter
@@ -93,20 +107,90 @@ typedef struct brf_job_data_s		// Job data
                                         // this page
   void                  *data;          // Job-type-specific data
   brf_printer_app_global_data_t *global_data; // Global data
+  char                  *envp[BRF_MAX_ENV];
+                                        // Environment for CUPS filters
+  char                  env_printer[1024],
+                                        // PRINTER=...
+                        env_location[1024];
+                                        // PRINTER_LOCATION=...
+  cf_filter_external_t  ext_params[BRF_MAX_FILTERS];
+                                        // CUPS filter parameters with the
+                                        // job's environment
+  cf_filter_filter_in_chain_t filters[BRF_MAX_FILTERS],
+                                        // Spooling conversion filters
+                        print_filter;   // Filter sending to the device
+  brf_print_filter_function_data_t print_params;
+                                        // Parameters for print_filter
 } brf_job_data_t;
 
 
+typedef struct brf_job_template_s	// Per-printer part of the job data
+{
+  struct brf_job_template_s *next;	// Next template
+  int			printer_id;	// Printer ID
+  int			num_options;	// Number of filter options
+  cups_option_t		*options;	// Filter options
+  char			env_printer[1024],
+					// PRINTER=...
+			env_location[1024];
+					// PRINTER_LOCATION=...
+} brf_job_template_t;
+
+
+// Pre-parsed IEEE-1284 device ID, only the keys used for driver matching
+#define BRF_DID_MAX_TOKENS	8	// Max comma-delimited tokens per key
+
+typedef enum brf_did_key_e		// Device ID keys used for matching
+{
+  BRF_DID_MFG,				// MANUFACTURER/MANU/MFG
+  BRF_DID_MDL,				// MODEL/MDL
+  BRF_DID_CMD,				// COMMAND SET/CMD
+  BRF_DID_MAX
+} brf_did_key_t;
+
+typedef struct brf_did_token_s		// Hashed device ID string
+{
+  unsigned		hash;		// Hash of the string
+  const char		*str;		// Start of the string, trimmed
+  size_t		len;		// Length of the string
+} brf_did_token_t;
+
+typedef struct brf_did_value_s		// Hashed device ID value
+{
+  bool			present;	// Is the key present?
+  brf_did_token_t	value;		// Whole value
+  int			num_tokens;	// Number of comma-delimited tokens
+  brf_did_token_t	tokens[BRF_DID_MAX_TOKENS];
+					// Comma-delimited tokens
+} brf_did_value_t;
+
+typedef struct brf_device_id_s		// Pre-parsed device ID
+{
+  brf_did_value_t	keys[BRF_DID_MAX];
+					// Hashed MFG/MDL/CMD values
+} brf_device_id_t;
+
+
 //
 // Local functions...
 //
 static bool BRFTestFilterCB(pappl_job_t *job,  pappl_device_t *device,void *cbdata) ; 
+static bool BRFUBRLFilterCB(pappl_job_t *job, pappl_device_t *device, void *cbdata);
+static void add_mime_filters(pappl_system_t *system);
 static int brf_print_filter_function(int inputfd,int outputfd, int inputseekable,cf_filter_data_t *data, void *parameters); 
 static const char *autoadd_cb(const char *device_info, const char *device_uri, const char *device_id, void *cbdata);
 static bool	driver_cb(pappl_system_t *system, const char *driver_name, const char *device_uri, const char *device_id, pappl_pr_driver_data_t *data, ipp_t **attrs, void *cbdata);
-static int	match_id(int num_did, cups_option_t *did, const char *match_id);
+static void	hash_id_value(const char *value, size_t len, brf_did_token_t *token);
+static void	init_driver_ids(void);
+static int	match_id(const brf_device_id_t *did, const brf_device_id_t *mid);
+static void	parse_id(const char *device_id, brf_device_id_t *did);
+static bool	same_id_token(const brf_did_token_t *a, const brf_did_token_t *b);
 static const char *mime_cb(const unsigned char *header, size_t headersize, void *data);
 static bool	printer_cb(const char *device_info, const char *device_uri, const char *device_id, pappl_system_t *system);
 static brf_job_data_t *_brfCreateJobData(pappl_job_t *job,pappl_pr_options_t *job_options);
+static void _brfDeleteJobData(brf_job_data_t *job_data);
+static void	event_cb(pappl_system_t *system, pappl_printer_t *printer, pappl_job_t *job, pappl_event_t event, void *data);
+static void	get_job_template(pappl_printer_t *printer, brf_job_data_t *job_data, int *num_options, cups_option_t **options);
 static pappl_system_t *system_cb(int num_options, cups_option_t *options, void *data);
 
 
@@ -114,14 +198,50 @@ static pappl_system_t *system_cb(int num_options, cups_option_t *options, void *
 // Local globals...
 //
 
+// The drv/*.drv files have no IEEE-1284 device IDs and the embossers do not
+// document theirs, so the MFG/MDL/CMD strings below are guesses based on the
+// model names; a device ID that does not match them simply is not auto-added.
 static pappl_pr_driver_t	brf_drivers[] =
-{					// Driver list
-{ "gen_brf",  "Generic",
-  NULL, NULL },
-
+{					// Driver list (models from drv/*.drv)
+  { "gen_brf",		"Generic Braille embosser",
+    "MFG:Generic;CMD:BRF;", NULL },
+  { "gen_ubrl",		"Generic UBRL generator",
+    "MFG:Generic;CMD:UBRL;", NULL },
+  { "indexv3_basicd",	"Index Basic-D V3",
+    "MFG:Index;MDL:Basic-D V3;", NULL },
+  { "indexv3_basics",	"Index Basic-S V3",
+    "MFG:Index;MDL:Basic-S V3;", NULL },
+  { "indexv3_4waves",	"Index 4-Waves PRO",
+    "MFG:Index;MDL:4-Waves PRO;", NULL },
+  { "indexv3_everestd",	"Index Everest-D V3",
+    "MFG:Index;MDL:Everest-D V3;", NULL },
+  { "indexv3_4x4pro",	"Index 4x4 PRO V3",
+    "MFG:Index;MDL:4x4 PRO V3;", NULL },
+  { "indexv4_basicd",	"Index Basic-D V4/V5",
+    "MFG:Index;MDL:Basic-D V4;", NULL },
+  { "indexv4_basics",	"Index Basic-S V4/V5",
+    "MFG:Index;MDL:Basic-S V4;", NULL },
+  { "indexv4_everestd",	"Index Everest-D V4/V5",
+    "MFG:Index;MDL:Everest-D V4;", NULL },
+  { "indexv4_brlbox",	"Index Braille Box V4/V5",
+    "MFG:Index;MDL:Braille Box V4;", NULL }
 };
+#define BRF_NUM_DRIVERS	(int)(sizeof(brf_drivers) / sizeof(brf_drivers[0]))
+
+static brf_device_id_t	brf_driver_ids[BRF_NUM_DRIVERS];
+					// Pre-parsed driver device IDs
+static pthread_once_t	brf_driver_ids_once = PTHREAD_ONCE_INIT;
+					// Initialization control
 static char			brf_statefile[1024];
 					// State file
+static brf_printer_app_global_data_t brf_global_data;
+					// Global data, set up in system_cb()
+static pthread_mutex_t	brf_templates_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// Mutex for the job templates
+static brf_job_template_t *brf_templates = NULL;
+					// Job templates of the printers
+static unsigned		brf_templates_changes = 0;
+					// Number of configuration changes
 
 
 //
@@ -135,7 +255,7 @@ main(int  argc,				// I - Number of command-line arguments
   return (papplMainloop(argc, argv,
                         "1.0",
                         NULL,
-                        (int)(sizeof(brf_drivers) / sizeof(brf_drivers[0])),
+                        BRF_NUM_DRIVERS,
                         brf_drivers, autoadd_cb, driver_cb,
                         /*subcmd_name*/NULL, /*subcmd_cb*/NULL,
                         system_cb,
@@ -154,50 +274,99 @@ autoadd_cb(const char *device_info,	// I - Device information/name (not used)
            const char *device_id,	// I - IEEE-1284 device ID
            void       *cbdata)		// I - Callback data (System)
 {
-  int		i,			// Looping var
-		score,			// Current driver match score
-	    	best_score = 0,		// Best score
-		num_did;		// Number of device ID key/value pairs
-  cups_option_t	*did;			// Device ID key/value pairs
-  const char	*make,			// Manufacturer name
-		*best_name = NULL;	// Best driver
- 
+  int			i,		// Looping var
+			score,		// Current driver match score
+			best_score = 0;	// Best score
+  brf_device_id_t	did;		// Parsed device ID
+  const char		*best_name = NULL;
+					// Best driver
 
 
   (void)device_info;
+  (void)device_uri;
+  (void)cbdata;
 
-  // First parse the device ID and get any potential driver name to match...
-  num_did = papplDeviceParseID(device_id, &did);
+  // Make sure the driver device IDs have been parsed...
+  pthread_once(&brf_driver_ids_once, init_driver_ids);
 
-  if ((make = cupsGetOption("MANUFACTURER", num_did, did)) == NULL)
-    if ((make = cupsGetOption("MANU", num_did, did)) == NULL)
-      make = cupsGetOption("MFG", num_did, did);
+  // First parse and hash the device ID once...
+  if (!device_id || !*device_id)
+    return (NULL);
 
-  
-  // // Then loop through the driver list to find the best match...
-  // for (i = 0; i < (int)(sizeof(brf_drivers) / sizeof(brf_drivers[0])); i ++)
+  parse_id(device_id, &did);
+
+  // Then loop through the driver list to find the best match...
+  for (i = 0; i < BRF_NUM_DRIVERS; i ++)
   {
- 
+    if (!brf_drivers[i].device_id)
+      continue;
 
-    if (brf_drivers[i].device_id)
+    // See if we have a matching device ID...
+    score = match_id(&did, brf_driver_ids + i);
+    if (score > best_score)
     {
-      // See if we have a matching device ID...
-      score = match_id(num_did, did, brf_drivers[i].device_id);
-      if (score > best_score)
-      {
-        best_score = score;
-        best_name  = brf_drivers[i].name;
-      }
+      best_score = score;
+      best_name  = brf_drivers[i].name;
     }
-   }
-
-  // Clean up and return...
-  cupsFreeOptions(num_did, did);
+  }
 
   return (best_name);
 }
 
 
+//
+// 'hash_id_value()' - Trim a string and compute its case-insensitive FNV-1a hash.
+//
+
+static void
+hash_id_value(const char      *value,	// I - Value
+              size_t          len,	// I - Length of value
+              brf_did_token_t *token)	// O - Hashed string
+{
+  unsigned	hash = 2166136261U;	// FNV-1a hash
+
+
+  while (len > 0 && isspace(*value & 255))
+  {
+    value ++;
+    len --;
+  }
+
+  while (len > 0 && isspace(value[len - 1] & 255))
+    len --;
+
+  token->str = value;
+  token->len = len;
+
+  for (; len > 0; len --, value ++)
+  {
+    hash ^= (unsigned)tolower(*value & 255);
+    hash *= 16777619U;
+  }
+
+  token->hash = hash;
+}
+
+
+//
+// 'init_driver_ids()' - Pre-parse the device IDs of the driver list.
+//
+
+static void
+init_driver_ids(void)
+{
+  int	i;				// Looping var
+
+
+  for (i = 0; i < BRF_NUM_DRIVERS; i ++)
+  {
+    if (brf_drivers[i].device_id)
+      parse_id(brf_drivers[i].device_id, brf_driver_ids + i);
+    else
+      memset(brf_driver_ids + i, 0, sizeof(brf_driver_ids[i]));
+  }
+}
+
 
 //
 // 'match_id()' - Compare two IEEE-1284 device IDs and return a score.
@@ -207,64 +376,150 @@ autoadd_cb(const char *device_info,	// I - Device information/name (not used)
 //
 
 static int				// O - Score
-match_id(int           num_did,		// I - Number of device ID key/value pairs
-         cups_option_t *did,		// I - Device ID key/value pairs
-         const char    *match_id)	// I - Driver's device ID match string
+match_id(const brf_device_id_t *did,	// I - Device's parsed device ID
+         const brf_device_id_t *mid)	// I - Driver's parsed device ID
 {
-  int		i,			// Looping var
-		score = 0,		// Score
-		num_mid;		// Number of match ID key/value pairs
-  cups_option_t	*mid,			// Match ID key/value pairs
-		*current;		// Current key/value pair
-  const char	*value,			// Device ID value
-		*valptr;		// Pointer into value
-
+  int			i,		// Looping var
+			j,		// Looping var
+			score = 0;	// Score
+  const brf_did_value_t	*dval,		// Device value
+			*mval;		// Match value
 
-  // Parse the matching device ID into key/value pairs...
-  if ((num_mid = papplDeviceParseID(match_id, &mid)) == 0)
-    return (0);
 
-  // Loop through the match pairs to find matches (or not)
-  for (i = num_mid, current = mid; i > 0; i --, current ++)
+  // Loop through the match keys to find matches (or not)
+  for (i = 0, dval = did->keys, mval = mid->keys; i < BRF_DID_MAX; i ++, dval ++, mval ++)
   {
-    if ((value = cupsGetOption(current->name, num_did, did)) == NULL)
-    {
-      // No match
-      score = 0;
-      break;
-    }
+    if (!mval->present)
+      continue;
+
+    if (!dval->present)
+      return (0);			// No match
 
-    if (!strcasecmp(current->value, value))
+    if (same_id_token(&dval->value, &mval->value))
     {
       // Full match!
       score += 2;
+      continue;
     }
-    else if ((valptr = strstr(value, current->value)) != NULL)
+
+    // Possible match with one of the comma-delimited fields...
+    for (j = 0; j < dval->num_tokens; j ++)
     {
-      // Possible substring match, check
-      size_t mlen = strlen(current->value);
-					// Length of match value
-      if ((valptr == value || valptr[-1] == ',') && (!valptr[mlen] || valptr[mlen] == ','))
-      {
-        // Partial match!
-        score ++;
-      }
-      else
-      {
-        // No match
-        score = 0;
+      if (same_id_token(dval->tokens + j, &mval->value))
         break;
-      }
     }
+
+    if (j < dval->num_tokens)
+      score ++;				// Partial match!
+    else
+      return (0);			// No match
+  }
+
+  return (score);
+}
+
+
+//
+// 'parse_id()' - Parse an IEEE-1284 device ID into hashed MFG/MDL/CMD keys.
+//
+// The parsed values point into the device ID string, which must stay valid
+// while they are used.
+//
+
+static void
+parse_id(const char      *device_id,	// I - IEEE-1284 device ID
+         brf_device_id_t *did)		// O - Parsed device ID
+{
+  const char		*ptr,		// Pointer into device ID
+			*name,		// Start of key name
+			*value,		// Start of value
+			*token;		// Start of token
+  size_t		namelen,	// Length of key name
+			valuelen;	// Length of value
+  brf_did_key_t		key;		// Key index
+  brf_did_value_t	*dval;		// Current value
+
+
+  memset(did, 0, sizeof(brf_device_id_t));
+
+  for (ptr = device_id; *ptr;)
+  {
+    // Get the "KEY:" part...
+    for (name = ptr; *ptr && *ptr != ':' && *ptr != ';'; ptr ++);
+
+    if (*ptr != ':')
+    {
+      // Malformed pair, skip it...
+      if (*ptr)
+        ptr ++;
+      continue;
+    }
+
+    namelen = (size_t)(ptr - name);
+
+    // Then the "value;" part...
+    for (value = ++ ptr; *ptr && *ptr != ';'; ptr ++);
+
+    valuelen = (size_t)(ptr - value);
+
+    if (*ptr)
+      ptr ++;
+
+    while (namelen > 0 && isspace(*name & 255))
+    {
+      name ++;
+      namelen --;
+    }
+
+    if ((namelen == 12 && !strncasecmp(name, "MANUFACTURER", 12)) ||
+        (namelen == 4 && !strncasecmp(name, "MANU", 4)) ||
+        (namelen == 3 && !strncasecmp(name, "MFG", 3)))
+      key = BRF_DID_MFG;
+    else if ((namelen == 5 && !strncasecmp(name, "MODEL", 5)) ||
+             (namelen == 3 && !strncasecmp(name, "MDL", 3)))
+      key = BRF_DID_MDL;
+    else if ((namelen == 11 && !strncasecmp(name, "COMMAND SET", 11)) ||
+             (namelen == 3 && !strncasecmp(name, "CMD", 3)))
+      key = BRF_DID_CMD;
     else
+      continue;
+
+    // The first occurrence of a key wins...
+    dval = did->keys + key;
+    if (dval->present)
+      continue;
+
+    dval->present = true;
+    hash_id_value(value, valuelen, &dval->value);
+
+    // Hash the comma-delimited tokens for partial matches...
+    for (token = value; token <= value + valuelen && dval->num_tokens < BRF_DID_MAX_TOKENS;)
     {
-      // No match
-      score = 0;
-      break;
+      const char *end = memchr(token, ',', (size_t)(value + valuelen - token));
+					// End of token
+
+      if (!end)
+        end = value + valuelen;
+
+      hash_id_value(token, (size_t)(end - token), dval->tokens + dval->num_tokens ++);
+      token = end + 1;
     }
   }
 }
 
+
+//
+// 'same_id_token()' - Compare two hashed device ID strings, ignoring case.
+//
+
+static bool				// O - `true` if the same, `false` otherwise
+same_id_token(const brf_did_token_t *a,	// I - First string
+              const brf_did_token_t *b)	// I - Second string
+{
+  return (a->hash == b->hash && a->len == b->len && !strncasecmp(a->str, b->str, a->len));
+}
+
+
 //
 // 'driver_cb()' - Main driver callback.
 //
@@ -280,10 +535,11 @@ driver_cb(
     void                   *cbdata)	// I - Callback data (not used)
 {
   int	i;				// Looping var
+  bool	ret;				// Return value
 
 
   // Copy make/model info...
-  for (i = 0; i < (int)(sizeof(brf_drivers) / sizeof(brf_drivers[0])); i ++)
+  for (i = 0; i < BRF_NUM_DRIVERS; i ++)
   {
     if (!strcmp(driver_name, brf_drivers[i].name))
     {
@@ -318,12 +574,193 @@ driver_cb(
 
   // Use the corresponding sub-driver callback to set things up...
   if (!strncmp(driver_name, "gen_", 4))
-    return (brf_gen(system, driver_name, device_uri, device_id, data, attrs, cbdata));
- 
+    ret = brf_gen(system, driver_name, device_uri, device_id, data, attrs, cbdata);
+  else if (!strncmp(driver_name, "indexv", 6))
+    ret = brf_index(system, driver_name, device_uri, device_id, data, attrs, cbdata);
   else
     return (false);
+
+  // Job scheduling options, the same for all drivers...
+  if (ret)
+    brf_sched_driver(data, attrs);
+
+  return (ret);
+}
+
+//
+// 'event_cb()' - Pass job events to the scheduler and drop the job template
+//               of a changed or deleted printer.
+//
+
+static void
+event_cb(
+    pappl_system_t  *system,		// I - System
+    pappl_printer_t *printer,		// I - Printer, if any
+    pappl_job_t     *job,		// I - Job, if any
+    pappl_event_t   event,		// I - Event
+    void            *data)		// I - Callback data (unused)
+{
+  brf_job_template_t	**prev,		// Pointer to current template
+			*t;		// Current template
+  int			printer_id;	// Printer ID
+
+
+  (void)system;
+  (void)data;
+
+  brf_sched_event(printer, job, event);
+
+  if (!printer || !(event & (PAPPL_EVENT_PRINTER_CONFIG_CHANGED | PAPPL_EVENT_PRINTER_DELETED)))
+    return;
+
+  printer_id = papplPrinterGetID(printer);
+
+  pthread_mutex_lock(&brf_templates_mutex);
+
+  brf_templates_changes ++;
+
+  for (prev = &brf_templates; (t = *prev) != NULL; prev = &t->next)
+  {
+    if (t->printer_id == printer_id)
+    {
+      *prev = t->next;
+      cupsFreeOptions(t->num_options, t->options);
+      free(t);
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&brf_templates_mutex);
 }
 
+
+//
+// 'get_job_template()' - Copy the printer's job template to the job data.
+//
+// Everything in the template only depends on the printer configuration, it
+// is created with the first job and kept until event_cb() drops it.  The
+// printer data is read without holding brf_templates_mutex: event_cb() takes
+// the mutex while PAPPL holds the printer lock, so the printer lock must not
+// be taken while holding it.
+//
+
+static void
+get_job_template(
+    pappl_printer_t *printer,		// I - Printer
+    brf_job_data_t  *job_data,		// I - Job data
+    int             *num_options,	// O - Number of filter options
+    cups_option_t   **options)		// O - Filter options
+{
+  brf_job_template_t	*t,		// Template
+			*newt;		// New template
+  int			printer_id = papplPrinterGetID(printer);
+					// Printer ID
+  pappl_pr_driver_data_t driver_data;	// Printer driver data
+  const char		*val;		// Printer name or location
+  char			buf[1024];	// Printer location
+  int			k = 0;		// Environment index
+  unsigned		changes;	// Configuration changes before reading
+  bool			temporary = false;
+					// Template only used for this job?
+
+
+  pthread_mutex_lock(&brf_templates_mutex);
+
+  for (t = brf_templates; t; t = t->next)
+  {
+    if (t->printer_id == printer_id)
+      break;
+  }
+
+  if (!t)
+  {
+    changes = brf_templates_changes;
+
+    pthread_mutex_unlock(&brf_templates_mutex);
+
+    // Create the template from the printer data without the mutex...
+    if ((newt = (brf_job_template_t *)calloc(1, sizeof(brf_job_template_t))) != NULL)
+    {
+      newt->printer_id = printer_id;
+
+      papplPrinterGetDriverData(printer, &driver_data);
+
+      // Add "ColorModel=Gray" to make filters converting color input to
+      // grayscale
+      if (!(driver_data.color_supported & PAPPL_COLOR_MODE_COLOR))
+        newt->num_options = cupsAddOption("ColorModel", "Gray", newt->num_options, &newt->options);
+
+      // Environment variables for filters
+      if ((val = papplPrinterGetName(printer)) != NULL && val[0])
+        snprintf(newt->env_printer, sizeof(newt->env_printer), "PRINTER=%s", val);
+      if ((val = papplPrinterGetLocation(printer, buf, sizeof(buf))) != NULL && buf[0])
+        snprintf(newt->env_location, sizeof(newt->env_location), "PRINTER_LOCATION=%s", val);
+    }
+
+    // ...then add it, unless another job was faster or the configuration
+    // changed meanwhile, the template may then be stale and is only used for
+    // this job
+    pthread_mutex_lock(&brf_templates_mutex);
+
+    for (t = brf_templates; t; t = t->next)
+    {
+      if (t->printer_id == printer_id)
+        break;
+    }
+
+    if (t && newt)
+    {
+      cupsFreeOptions(newt->num_options, newt->options);
+      free(newt);
+    }
+    else if (newt && changes != brf_templates_changes)
+    {
+      t         = newt;
+      temporary = true;
+    }
+    else if (newt)
+    {
+      t             = newt;
+      t->next       = brf_templates;
+      brf_templates = t;
+    }
+  }
+
+  if (t)
+  {
+    // Environment, per job so that jobs on different printers do not need to
+    // share the process environment
+    if (t->env_printer[0])
+    {
+      memcpy(job_data->env_printer, t->env_printer, sizeof(job_data->env_printer));
+      job_data->envp[k ++] = job_data->env_printer;
+    }
+    if (t->env_location[0])
+    {
+      memcpy(job_data->env_location, t->env_location, sizeof(job_data->env_location));
+      job_data->envp[k ++] = job_data->env_location;
+    }
+
+    *num_options = brf_arena_copy_options(job_data->arena, t->num_options, t->options, options);
+  }
+  else
+  {
+    *num_options = 0;
+    *options     = NULL;
+  }
+
+  job_data->envp[k] = NULL;
+
+  pthread_mutex_unlock(&brf_templates_mutex);
+
+  if (temporary)
+  {
+    cupsFreeOptions(t->num_options, t->options);
+    free(t);
+  }
+}
+
+
 //
 // 'mime_cb()' - MIME typing callback...
 //
@@ -333,10 +770,9 @@ mime_cb(const unsigned char *header,	// I - Header data
         size_t              headersize,	// I - Size of header data
         void                *cbdata)	// I - Callback data (not used)
 {
-  
-    return (brf_TESTPAGE_MIMETYPE);
-  
-  
+  (void)cbdata;
+
+  return (brf_mime_type(header, headersize));
 }
 
 
@@ -396,6 +832,18 @@ printer_cb(const char     *device_info,	// I - Device information
 }
 
 
+//
+// 'brf_is_brf_format()' - Is a document format BRF, sent to the embosser as it
+//                         is?
+//
+
+bool					// O - `true` for BRF formats
+brf_is_brf_format(const char *format)	// I - Document format
+{
+  return (format && (!strcmp(format, "application/vnd.cups-brf") || !strcmp(format, "application/vnd.cups-paged-brf")));
+}
+
+
 //
 // 'system_cb()' - Setup the system object.
 //
@@ -491,12 +939,23 @@ system_cb(
     return (NULL);
 
   papplSystemAddListeners(system, NULL);
+
+  brf_global_data.system = system;
+  if ((val = cupsGetOption("spool-directory", num_options, options)) == NULL && (val = getenv("TMPDIR")) == NULL)
+    val = "/tmp";
+  papplCopyString(brf_global_data.spool_dir, val, sizeof(brf_global_data.spool_dir));
+  brf_spool_init(brf_global_data.spool_dir, cupsGetOption("spool-memory", num_options, options));
   papplSystemSetHostName(system, hostname);
 
   papplSystemSetMIMECallback(system, mime_cb, NULL);
-  papplSystemAddMIMEFilter(system, "application/pdf", brf_TESTPAGE_MIMETYPE, BRFTestFilterCB, NULL);
+  papplSystemSetEventCallback(system, event_cb, NULL);
+  add_mime_filters(system);
+  brf_metrics_register(system);
+  brf_pool_register();
+  brf_sched_register(system);
 
-  papplSystemSetPrinterDrivers(system, (int)(sizeof(brf_drivers) / sizeof(brf_drivers[0])), brf_drivers, autoadd_cb, /*create_cb*/NULL, driver_cb, system);
+  pthread_once(&brf_driver_ids_once, init_driver_ids);
+  papplSystemSetPrinterDrivers(system, BRF_NUM_DRIVERS, brf_drivers, autoadd_cb, /*create_cb*/NULL, driver_cb, system);
 
   
   papplSystemSetFooterHTML(system, "Copyright &copy; 2022 by Chandresh Soni. All rights reserved.");
@@ -523,16 +982,6 @@ system_cb(
 //
 
 
-// Data for brf_print_filter_function()
-typedef struct brf_print_filter_function_data_s
-// look-up table
-{
-  pappl_device_t *device;                    // Device
-  const char *device_uri;                          // Printer device URI
-  pappl_job_t *job;                          // Job
-  brf_printer_app_global_data_t *global_data; // Global data
-} brf_print_filter_function_data_t;
-
 typedef struct brf_cups_device_data_s
 {
   const char *device_uri;    // Device URI
@@ -570,42 +1019,126 @@ static cf_filter_external_t filter_data_ext =
       NULL,
       NULL
     };
-static brf_spooling_conversion_t brf_convert_pdf_to_brf =
+static cf_filter_external_t filter_data_musicxml =
     {
-        "application/pdf",
-        "application/vnd.cups-paged-brf",
-        1,
-        {
-          {
-            cfFilterExternal,
-            (void *)(&filter_data_ext),
-            "texttobrf"
-          }
-        }
-     };
+      "/usr/lib/cups/filter/musicxmltobrf",
+      0,
+      0,
+      NULL,
+      NULL
+    };
+static cf_filter_external_t filter_data_image =
+    {
+      "/usr/lib/cups/filter/imagetobrf",
+      0,
+      0,
+      NULL,
+      NULL
+    };
+static cf_filter_external_t filter_data_brf =
+    {
+      "/usr/lib/cups/filter/brftopagedbrf",
+      0,
+      0,
+      NULL,
+      NULL
+    };
+
+#define BRF_CONVERSION(name, srctype, params, filter) \
+static brf_spooling_conversion_t name = \
+    { \
+        srctype, \
+        brf_TESTPAGE_MIMETYPE, \
+        1, \
+        { \
+          { \
+            cfFilterExternal, \
+            (void *)(params), \
+            filter \
+          } \
+        } \
+     }
+
+BRF_CONVERSION(brf_convert_pdf_to_brf, "application/pdf", &filter_data_ext, "texttobrf");
+BRF_CONVERSION(brf_convert_text_to_brf, "text/plain", &filter_data_ext, "texttobrf");
+BRF_CONVERSION(brf_convert_html_to_brf, "text/html", &filter_data_ext, "texttobrf");
+BRF_CONVERSION(brf_convert_xml_to_brf, "application/xml", &filter_data_ext, "texttobrf");
+BRF_CONVERSION(brf_convert_rtf_to_brf, "text/rtf", &filter_data_ext, "texttobrf");
+BRF_CONVERSION(brf_convert_doc_to_brf, "application/msword", &filter_data_ext, "texttobrf");
+BRF_CONVERSION(brf_convert_docx_to_brf, "application/vnd.openxmlformats-officedocument.wordprocessingml.document", &filter_data_ext, "texttobrf");
+BRF_CONVERSION(brf_convert_odt_to_brf, "application/vnd.oasis.opendocument.text", &filter_data_ext, "texttobrf");
+BRF_CONVERSION(brf_convert_musicxml_to_brf, "application/vnd.recordare.musicxml+xml", &filter_data_musicxml, "musicxmltobrf");
+BRF_CONVERSION(brf_convert_png_to_brf, "image/png", &filter_data_image, "imagetobrf");
+BRF_CONVERSION(brf_convert_jpeg_to_brf, "image/jpeg", &filter_data_image, "imagetobrf");
+BRF_CONVERSION(brf_convert_gif_to_brf, "image/gif", &filter_data_image, "imagetobrf");
+BRF_CONVERSION(brf_convert_tiff_to_brf, "image/tiff", &filter_data_image, "imagetobrf");
+BRF_CONVERSION(brf_convert_brf_to_paged_brf, "application/vnd.cups-brf", &filter_data_brf, "brftopagedbrf");
+
+// Spooling conversions, each is registered as a MIME filter so that the
+// format found by mime_cb() selects its conversion directly
+static brf_spooling_conversion_t *brf_spooling_conversions[] =
+{
+  &brf_convert_pdf_to_brf,
+  &brf_convert_text_to_brf,
+  &brf_convert_html_to_brf,
+  &brf_convert_xml_to_brf,
+  &brf_convert_rtf_to_brf,
+  &brf_convert_doc_to_brf,
+  &brf_convert_docx_to_brf,
+  &brf_convert_odt_to_brf,
+  &brf_convert_musicxml_to_brf,
+  &brf_convert_png_to_brf,
+  &brf_convert_jpeg_to_brf,
+  &brf_convert_gif_to_brf,
+  &brf_convert_tiff_to_brf,
+  &brf_convert_brf_to_paged_brf
+};
+#define BRF_NUM_CONVERSIONS	(int)(sizeof(brf_spooling_conversions) / sizeof(brf_spooling_conversions[0]))
+
+
+//
+// 'add_mime_filters()' - Register the spooling conversions as MIME filters.
+//
+
+static void
+add_mime_filters(
+    pappl_system_t *system)		// I - System
+{
+  int	i;				// Looping var
+
+
+  for (i = 0; i < BRF_NUM_CONVERSIONS; i ++)
+    papplSystemAddMIMEFilter(system, brf_spooling_conversions[i]->srctype, brf_spooling_conversions[i]->dsttype, BRFTestFilterCB, brf_spooling_conversions[i]);
+
+  papplSystemAddMIMEFilter(system, "image/vnd.cups-ubrl", brf_TESTPAGE_MIMETYPE, BRFUBRLFilterCB, NULL);
+  papplSystemAddMIMEFilter(system, "application/vnd.cups-paged-ubrl", brf_TESTPAGE_MIMETYPE, BRFUBRLFilterCB, NULL);
+}
+
 
 bool // O - `true` on success, `false` on failure
 BRFTestFilterCB(
     pappl_job_t *job,       // I - Job
     pappl_device_t *device, // I - Output device
-    void *cbdata)           // I - Callback data (not used)
+    void *cbdata)           // I - Spooling conversion or `NULL`
 {
-  pappl_pr_options_t *job_options = papplJobCreatePrintOptions(job, INT_MAX, 0);
+  pappl_pr_options_t *job_options;           // Job options
   brf_spooling_conversion_t *conversion;     // Spooling conversion to use
                                              // for pre-filtering
   cf_filter_filter_in_chain_t *chain_filter, // Filter in chain
       *print;
   brf_cups_device_data_t *device_data = NULL;
   brf_print_filter_function_data_t *print_params;
-  brf_printer_app_global_data_t *global_data;
   brf_job_data_t *job_data;
-  cups_array_t *spooling_conversions;
   cups_array_t *chain;
+  brf_metrics_t *metrics;   // Per-stage instrumentation
   const char *informat;
   const char *filename;     // Input filename
   int fd;                   // Input file descriptor
 
-  int nullfd;               // File descriptor for /dev/null
+  int outfd;                // File descriptor for the chain output
+  char spoolname[64];       // Name of the spooled output for a pool
+  size_t reserved = 0;      // Spooled output counted against the budget
+  struct stat fileinfo;     // Input file information
 
   bool ret = false;    // Return value
   int num_options = 0; 
@@ -615,15 +1148,19 @@ BRFTestFilterCB(
   pappl_pr_driver_data_t driver_data;
   pappl_printer_t *printer = papplJobGetPrinter(job);
   const char *device_uri = papplPrinterGetDeviceURI(printer);
-  spooling_conversions = cupsArrayNew(NULL, NULL);
-  cupsArrayAdd(spooling_conversions, &brf_convert_pdf_to_brf);
+  bool pool = brf_pool_printer(printer); // Split among a pool's members?
 
-    job_options = papplJobCreatePrintOptions(job, INT_MAX, 1);
+  job_options = papplJobCreatePrintOptions(job, INT_MAX, 1);
 
   papplLogJob(job, PAPPL_LOGLEVEL_DEBUG,
 	      "Printing job in spooling mode");
 
-  job_data = _brfCreateJobData(job, job_options);
+  if ((job_data = _brfCreateJobData(job, job_options)) == NULL)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate memory for job: %s", strerror(errno));
+    papplJobDeletePrintOptions(job_options);
+    return (false);
+  }
 
   
 
@@ -637,6 +1174,8 @@ BRFTestFilterCB(
   {
     papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to open input file '%s' for printing: %s",
                 filename, strerror(errno));
+    _brfDeleteJobData(job_data);
+    papplJobDeletePrintOptions(job_options);
     return (false);
   }
 
@@ -652,28 +1191,29 @@ BRFTestFilterCB(
 
   //    return (false);
 
-  // Find filters to use for this job
+  // Find filters to use for this job, the conversion is normally passed in
+  // when the MIME filter is registered
   //
 
-  for (conversion =
-           (brf_spooling_conversion_t *)
-               cupsArrayFirst(spooling_conversions);
-       conversion;
-       conversion =
-           (brf_spooling_conversion_t *)
-               cupsArrayNext(spooling_conversions))
-   
+  if ((conversion = (brf_spooling_conversion_t *)cbdata) == NULL)
   {
-    if (strcmp(conversion->srctype, informat) == 0)
-
-      break;
-    
+    for (int i = 0; i < BRF_NUM_CONVERSIONS; i ++)
+    {
+      if (strcmp(brf_spooling_conversions[i]->srctype, informat) == 0)
+      {
+        conversion = brf_spooling_conversions[i];
+        break;
+      }
+    }
   }
   if (conversion == NULL )
   {
     papplLogJob(job, PAPPL_LOGLEVEL_ERROR,
                 "No pre-filter found for input format %s",
                 informat);
+    close(fd);
+    _brfDeleteJobData(job_data);
+    papplJobDeletePrintOptions(job_options);
     return (false);
   }
   // Set input and output formats for the filter chain
@@ -699,27 +1239,37 @@ BRFTestFilterCB(
 
   chain = cupsArrayNew(NULL, NULL);
 
-  for (int i = 0; i < conversion->num_filters; i++){
-    cupsArrayAdd(chain, &(conversion->filters[i]));
-   
+  for (int i = 0; i < conversion->num_filters && i < BRF_MAX_FILTERS; i++){
+    // The conversions are shared by all jobs, so CUPS filters get a copy of
+    // their parameters with the job's own environment
+    chain_filter = job_data->filters + i;
+    *chain_filter = conversion->filters[i];
+
+    if (chain_filter->function == cfFilterExternal)
+    {
+      job_data->ext_params[i]      = *(cf_filter_external_t *)chain_filter->parameters;
+      job_data->ext_params[i].envp = job_data->envp;
+      chain_filter->parameters     = job_data->ext_params + i;
+    }
+
+    cupsArrayAdd(chain, chain_filter);
     }
     
-    chain_filter = NULL;
-  print =
-      (cf_filter_filter_in_chain_t *)calloc(1, sizeof(cf_filter_filter_in_chain_t));
   // Put filter function to send data to PAPPL's built-in backend at the end
-  // of the chain
-  print_params =
-      (brf_print_filter_function_data_t *)
-          calloc(1, sizeof(brf_print_filter_function_data_t));
-  print_params->device = device;
-  print_params->device_uri = device_uri;
-  print_params->job = job;
-  print_params->global_data = global_data;
-  print->function = brf_print_filter_function;
-  print->parameters = print_params;
-  print->name = "Backend";
-  cupsArrayAdd(chain, print);
+  // of the chain, a pool sends the BRF to its members itself
+  if (!pool)
+  {
+    print        = &job_data->print_filter;
+    print_params = &job_data->print_params;
+    print_params->device = device;
+    print_params->device_uri = device_uri;
+    print_params->job = job;
+    print_params->global_data = job_data->global_data;
+    print->function = brf_print_filter_function;
+    print->parameters = print_params;
+    print->name = "Backend";
+    cupsArrayAdd(chain, print);
+  }
 
   // //
   // // Update status
@@ -733,12 +1283,52 @@ BRFTestFilterCB(
 
   papplJobSetImpressions(job, 1);
 
-  // The filter chain has no output, data is going to the device
-  nullfd = open("/dev/null", O_RDWR);
+  if (pool)
+  {
+    // The BRF is spooled, to be split among the members, it is about as
+    // large as the document
+    snprintf(spoolname, sizeof(spoolname), "pool-%d", papplJobGetID(job));
+    if ((outfd = brf_spool_create(spoolname, fstat(fd, &fileinfo) ? 0 : (size_t)fileinfo.st_size, &reserved)) < 0)
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to spool '%s': %s", spoolname, strerror(errno));
+  }
+  else
+  {
+    // The filter chain has no output, data is going to the device
+    outfd = open("/dev/null", O_RDWR);
+  }
 
-  if (cfFilterChain(fd, nullfd, 1, job_data->filter_data, chain) == 0)
+  // Measure each stage, fall back to the plain chain if this is not possible
+  metrics = brf_metrics_new(chain);
+
+  if (outfd >= 0 && cfFilterChain(fd, outfd, 1, job_data->filter_data, metrics ? brf_metrics_chain(metrics) : chain) == 0)
     ret = true;
 
+  brf_metrics_delete(metrics, job);
+  cupsArrayDelete(chain);
+  close(fd);
+
+  if (pool && outfd >= 0)
+  {
+    // The filters have already selected the page ranges
+    if (ret && lseek(outfd, 0, SEEK_SET) < 0)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to spool '%s': %s", spoolname, strerror(errno));
+      ret = false;
+    }
+    else if (ret)
+      ret = brf_pool_print(job, job_options, outfd, false);
+
+    brf_spool_close(outfd, reserved);
+  }
+  else if (outfd >= 0)
+    close(outfd);
+
+  if (device_data)
+    device_data->filter_data = NULL;
+
+  _brfDeleteJobData(job_data);
+  papplJobDeletePrintOptions(job_options);
+
   // //
   // // Update status
   // //
@@ -748,6 +1338,58 @@ BRFTestFilterCB(
   return (ret);
 }
 
+//
+// 'BRFUBRLFilterCB()' - Print Unicode braille graphics.
+//
+
+static bool				// O - `true` on success, `false` on failure
+BRFUBRLFilterCB(
+    pappl_job_t    *job,		// I - Job
+    pappl_device_t *device,		// I - Output device
+    void           *cbdata)		// I - Callback data (not used)
+{
+  pappl_printer_t	*printer = papplJobGetPrinter(job);
+					// Printer
+  pappl_pr_options_t	*options;	// Job options
+  int			fd;		// Input file
+  bool			ret;		// Return value
+
+
+  (void)cbdata;
+
+  if (strncmp(papplPrinterGetDriverName(printer), "indexv", 6))
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Braille graphics are only supported by Index embossers.");
+    return (false);
+  }
+
+  if (brf_pool_printer(printer))
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Braille graphics cannot be split among the embossers of a pool.");
+    return (false);
+  }
+
+  if ((fd = open(papplJobGetFilename(job), O_RDONLY)) < 0)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to open input file '%s' for printing: %s", papplJobGetFilename(job), strerror(errno));
+    return (false);
+  }
+
+  papplJobSetImpressions(job, 1);
+
+  options = papplJobCreatePrintOptions(job, INT_MAX, 0);
+  ret     = brf_index_print_ubrl(job, options, device, fd);
+  papplJobDeletePrintOptions(options);
+
+  close(fd);
+
+  if (ret)
+    papplJobSetImpressionsCompleted(job, 1);
+
+  return (ret);
+}
+
+
 int                                               // O - Error status
 brf_print_filter_function(int inputfd,            // I - File descriptor input
                                                   //     stream
@@ -771,6 +1413,13 @@ brf_print_filter_function(int inputfd,            // I - File descriptor input
   char filename[2048]; // Name for debug copy of the
                        // job
   int debug_fd = -1;   // File descriptor for debug copy
+  brf_scan_t scan;     // Page counts of the paged BRF
+  pappl_pr_options_t *options; // Job options
+  char spoolname[256]; // Name of the spooled BRF
+  size_t reserved = 0; // Spool memory of the BRF
+  bool spooled = false; // Is the BRF spooled?
+  struct stat fileinfo; // Job document information
+  bool ok;             // Did the output succeed?
 
   (void)inputseekable;
 
@@ -791,6 +1440,88 @@ brf_print_filter_function(int inputfd,            // I - File descriptor input
     debug_fd = open(filename, O_CREAT | O_WRONLY, S_IRUSR | S_IWUSR);
   }
 
+  // The output of the filter chain comes through a pipe, spool it so that
+  // the pages and the embossing time of the job can be estimated before
+  // anything goes to the embosser; the BRF is about as large as the document
+  if (lseek(inputfd, 0, SEEK_CUR) < 0)
+  {
+    snprintf(spoolname, sizeof(spoolname), "brf-%d", papplJobGetID(job));
+    if ((ok = (outputfd = brf_spool_create(spoolname, stat(papplJobGetFilename(job), &fileinfo) ? 0 : (size_t)fileinfo.st_size, &reserved)) >= 0) == false)
+    {
+      if (log)
+        log(ld, CF_LOGLEVEL_ERROR, "Backend: Unable to spool '%s': %s",
+            spoolname, strerror(errno));
+    }
+
+    while (ok && (bytes = read(inputfd, buffer, sizeof(buffer))) > 0)
+    {
+      if (write(outputfd, buffer, (size_t)bytes) != bytes)
+      {
+        if (log)
+          log(ld, CF_LOGLEVEL_ERROR, "Backend: Unable to spool '%s': %s",
+              spoolname, strerror(errno));
+        ok = false;
+      }
+    }
+
+    if (ok && lseek(outputfd, 0, SEEK_SET) < 0)
+    {
+      if (log)
+        log(ld, CF_LOGLEVEL_ERROR, "Backend: Unable to spool '%s': %s",
+            spoolname, strerror(errno));
+      ok = false;
+    }
+
+    // Read the spooled BRF from now on, the output of the filter function
+    // is not used
+    close(inputfd);
+    inputfd = outputfd;
+    outputfd = -1;
+    spooled = true;
+
+    if (!ok)
+    {
+      if (debug_fd >= 0)
+        close(debug_fd);
+      if (inputfd >= 0)
+        brf_spool_close(inputfd, reserved);
+      return (1);
+    }
+  }
+
+  printer = papplJobGetPrinter(job);
+  options = papplJobCreatePrintOptions(job, INT_MAX, 0);
+
+  if (!strncmp(papplPrinterGetDriverName(printer), "indexv", 6))
+  {
+    // Index embossers need the BRF to be encoded in transparent mode, the
+    // estimate is done there
+    if (debug_fd >= 0)
+      close(debug_fd);
+
+    ok = brf_index_print_brf(job, options, device, inputfd);
+    papplDeviceFlush(device);
+    papplJobDeletePrintOptions(options);
+
+    if (spooled)
+      brf_spool_close(inputfd, reserved);
+    else
+      close(inputfd);
+    if (outputfd >= 0)
+      close(outputfd);
+    return (ok ? 0 : 1);
+  }
+
+  // Estimate pages and embossing time...
+  brf_scan_init(&scan);
+  while ((bytes = read(inputfd, buffer, sizeof(buffer))) > 0)
+    brf_scan_data(&scan, buffer, (size_t)bytes);
+  brf_scan_finish(&scan);
+
+  brf_estimate_job(job, options, &scan);
+  papplJobDeletePrintOptions(options);
+  lseek(inputfd, 0, SEEK_SET);
+
   while ((bytes = read(inputfd, buffer, sizeof(buffer))) > 0)
   {
     if (debug_fd >= 0)
@@ -803,7 +1534,6 @@ brf_print_filter_function(int inputfd,            // I - File descriptor input
         close(debug_fd);
         debug_fd = -1;
       }
-    return (false);
 
     if (papplDeviceWrite(device, buffer, (size_t)bytes) < 0)
     {
@@ -813,18 +1543,28 @@ brf_print_filter_function(int inputfd,            // I - File descriptor input
             (int)bytes);
       if (debug_fd >= 0)
         close(debug_fd);
-      close(inputfd);
-      close(outputfd);
+      if (spooled)
+        brf_spool_close(inputfd, reserved);
+      else
+        close(inputfd);
+      if (outputfd >= 0)
+        close(outputfd);
       return (1);
     }
   }
   papplDeviceFlush(device);
 
+  papplJobSetImpressionsCompleted(job, papplJobGetImpressions(job));
+
   if (debug_fd >= 0)
     close(debug_fd);
 
-  close(inputfd);
-  close(outputfd);
+  if (spooled)
+    brf_spool_close(inputfd, reserved);
+  else
+    close(inputfd);
+  if (outputfd >= 0)
+    close(outputfd);
   return (0);
 }
 
@@ -836,20 +1576,13 @@ _brfCreateJobData(pappl_job_t *job,
   int                   i, j, k, count, intval = 0;
   
   brf_job_data_t         *job_data;      // PPD data for job
-  pappl_pr_driver_data_t driver_data;   // Printer driver data
   int		        num_options = 0;// Number of PPD print options
   cups_option_t	        *options = NULL;// PPD print options
   cups_option_t         *opt;
-  ipp_t                 *driver_attrs;  // Printer (driver) IPP attributes
   char                  buf[1024];      // Buffer for building strings
   const char            *choicestr,     // Choice name from PPD option
                         *val;           // Value string from IPP option
-  ipp_t                 *attrs;         // IPP Attributes structure
-  ipp_t		        *media_col,	// media-col IPP structure
-                        *media_size;	// media-size IPP structure
   ipp_attribute_t       *attr;
-  int                   pcm;            // Print color mode: 0: mono,
-                                        // 1: color (for presets)
   int                   pq;             // IPP Print quality value (for presets)
   int                   pco;            // IPP Content optimize (for presets)
   int		        num_presets;	// Number of presets
@@ -861,6 +1594,7 @@ _brfCreateJobData(pappl_job_t *job,
   char                  paramstr[1024];
   time_t                t;
   cf_filter_data_t      *filter_data;
+  brf_arena_t           *arena;         // Memory for the job
   
   const char * const extra_attributes[] =
   {
@@ -876,17 +1610,22 @@ _brfCreateJobData(pappl_job_t *job,
   // cache
   //
 
-  job_data = (brf_job_data_t *)calloc(1, sizeof(brf_job_data_t));
+  if ((arena = brf_arena_new()) == NULL)
+    return (NULL);
+
+  job_data = (brf_job_data_t *)brf_arena_alloc(arena, sizeof(brf_job_data_t));
+  job_data->arena = arena;
+  job_data->global_data = &brf_global_data;
 
-  papplPrinterGetDriverData(printer, &driver_data);
   job_data->device_uri = (char *)papplPrinterGetDeviceURI(printer);
-  
-  driver_attrs = papplPrinterGetDriverAttributes(printer);
 
   //
-  // Find the PPD (or filter) options corresponding to the job options
+  // Start with the options and environment which only depend on the printer,
+  // then add the ones of this job
   //
 
+  get_job_template(printer, job_data, &num_options, &options);
+
   // Job options without PPD equivalent
   //  - print-darkness
   //  - darkness-configured
@@ -901,7 +1640,7 @@ _brfCreateJobData(pappl_job_t *job,
   {
     snprintf(buf, sizeof(buf), "%d-%d",
 	     job_options->first_page, job_options->last_page);
-    num_options = cupsAddOption("page-ranges", buf, num_options, &(options));
+    num_options = brf_arena_add_option(arena, "page-ranges", buf, num_options, &(options));
   }
 
   // // Finishings
@@ -917,28 +1656,6 @@ _brfCreateJobData(pappl_job_t *job,
 	// 				      num_options, &(options));
 
   // PageSize/media/media-size/media-size-name
-  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Adding option: PageSize");
-  attrs = ippNew();
-  media_col = ippNew();
-  media_size = ippNew();
-  ippAddInteger(media_size, IPP_TAG_PRINTER, IPP_TAG_INTEGER,
-		"x-dimension", job_options->media.size_width);
-  ippAddInteger(media_size, IPP_TAG_PRINTER, IPP_TAG_INTEGER,
-		"y-dimension", job_options->media.size_length);
-  ippAddCollection(media_col, IPP_TAG_PRINTER, "media-size", media_size);
-  ippDelete(media_size);
-  ippAddString(media_col, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "media-size-name",
-	       NULL, job_options->media.size_name);
-  ippAddInteger(media_col, IPP_TAG_PRINTER, IPP_TAG_INTEGER,
-		"media-left-margin", job_options->media.left_margin);
-  ippAddInteger(media_col, IPP_TAG_PRINTER, IPP_TAG_INTEGER,
-		"media-right-margin", job_options->media.right_margin);
-  ippAddInteger(media_col, IPP_TAG_PRINTER, IPP_TAG_INTEGER,
-		"media-top-margin", job_options->media.top_margin);
-  ippAddInteger(media_col, IPP_TAG_PRINTER, IPP_TAG_INTEGER,
-		"media-bottom-margin", job_options->media.bottom_margin);
-  ippAddCollection(attrs, IPP_TAG_PRINTER, "media-col", media_col);
-  ippDelete(media_col);
   papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "  Requesting size: W=%d H=%d L=%d R=%d T=%d B=%d (1/100 mm)",
 	      job_options->media.size_width, job_options->media.size_length,
 	      job_options->media.left_margin, job_options->media.right_margin,
@@ -947,7 +1664,6 @@ _brfCreateJobData(pappl_job_t *job,
   //   num_options = cupsAddOption("PageSize", choicestr,
 	// 				  num_options,
 	// 				  &(options));
-  ippDelete(attrs);
 
   // // InputSlot/media-source
   // papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Adding option: %s",
@@ -972,36 +1688,27 @@ _brfCreateJobData(pappl_job_t *job,
       job_options->orientation_requested <  IPP_ORIENT_NONE)
   {
     snprintf(buf, sizeof(buf), "%d", job_options->orientation_requested);
-    num_options = cupsAddOption("orientation-requested", buf,
+    num_options = brf_arena_add_option(arena, "orientation-requested", buf,
 				num_options, &(options));
   }
-  // Add "ColorModel=Gray" to make filters converting color input to grayscale
-  if (pcm == 0)
-  {
-    if (cupsGetOption("ColorModel", num_options,
-		      options) == NULL)
-      num_options = cupsAddOption("ColorModel", "Gray",
-				  num_options, &(options));
-  }
-
   // print-scaling (filter option)
   papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Adding option: print-scaling");
   if (job_options->print_scaling)
   {
     if (job_options->print_scaling & PAPPL_SCALING_AUTO)
-      num_options = cupsAddOption("print-scaling", "auto",
+      num_options = brf_arena_add_option(arena, "print-scaling", "auto",
 				  num_options, &(options));
     if (job_options->print_scaling & PAPPL_SCALING_AUTO_FIT)
-      num_options = cupsAddOption("print-scaling", "auto-fit",
+      num_options = brf_arena_add_option(arena, "print-scaling", "auto-fit",
 				  num_options, &(options));
     if (job_options->print_scaling & PAPPL_SCALING_FILL)
-      num_options = cupsAddOption("print-scaling", "fill",
+      num_options = brf_arena_add_option(arena, "print-scaling", "fill",
 				  num_options, &(options));
     if (job_options->print_scaling & PAPPL_SCALING_FIT)
-      num_options = cupsAddOption("print-scaling", "fit",
+      num_options = brf_arena_add_option(arena, "print-scaling", "fit",
 				  num_options, &(options));
     if (job_options->print_scaling & PAPPL_SCALING_NONE)
-      num_options = cupsAddOption("print-scaling", "none",
+      num_options = brf_arena_add_option(arena, "print-scaling", "none",
 				  num_options, &(options));
   }
 
@@ -1010,20 +1717,20 @@ _brfCreateJobData(pappl_job_t *job,
   for (i = 0; extra_attributes[i]; i ++)
     if ((attr = papplJobGetAttribute(job, extra_attributes[i])) != NULL &&
 	(val = ippGetString(attr, 0, NULL)) != NULL)
-      num_options = cupsAddOption(extra_attributes[i], val,
+      num_options = brf_arena_add_option(arena, extra_attributes[i], val,
 				  num_options, &(options));
 
   // Add options with time of creation and time of processing of the job
   if ((t = papplJobGetTimeCreated(job)) > 0)
   {
     snprintf(buf, sizeof(buf) - 1, "%ld", t);
-    num_options = cupsAddOption("time-at-creation", buf,
+    num_options = brf_arena_add_option(arena, "time-at-creation", buf,
 				num_options, &(options));
   }
   if ((t = papplJobGetTimeProcessed(job)) > 0)
   {
     snprintf(buf, sizeof(buf) - 1, "%ld", t);
-    num_options = cupsAddOption("time-at-processing", buf,
+    num_options = brf_arena_add_option(arena, "time-at-processing", buf,
 				num_options, &(options));
   }
 
@@ -1032,28 +1739,14 @@ _brfCreateJobData(pappl_job_t *job,
   for (i = num_options, opt = options; i > 0; i --, opt ++)
     papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "  %s=%s", opt->name, opt->value);
 
-  // Set environment variables for filters
-  if ((val = papplPrinterGetName(printer)) != NULL && val[0])
-    setenv("PRINTER", val, 1);
-  else
-    unsetenv("PRINTER");
-  if ((val = papplPrinterGetLocation(printer, buf, sizeof(buf))) != NULL &&
-      buf[0])
-    setenv("PRINTER_LOCATION", val, 1);
-  else
-    unsetenv("PRINTER_LOCATION");
-
-  // Clean up
-  ippDelete(driver_attrs);
-
   // Prepare job data to be supplied to filter functions/CUPS filters
   // called during job execution
-  filter_data = (cf_filter_data_t *)calloc(1, sizeof(cf_filter_data_t));
+  filter_data = (cf_filter_data_t *)brf_arena_alloc(arena, sizeof(cf_filter_data_t));
   job_data->filter_data = filter_data;
-  filter_data->printer = strdup(papplPrinterGetName(printer));
+  filter_data->printer = brf_arena_strdup(arena, papplPrinterGetName(printer));
   filter_data->job_id = papplJobGetID(job);
-  filter_data->job_user = strdup(papplJobGetUsername(job));
-  filter_data->job_title = strdup(papplJobGetName(job));
+  filter_data->job_user = brf_arena_strdup(arena, papplJobGetUsername(job));
+  filter_data->job_title = brf_arena_strdup(arena, papplJobGetName(job));
   filter_data->copies = job_options->copies;
   filter_data->job_attrs = NULL;     // We use PPD/filter options
   filter_data->printer_attrs = NULL; // We use the printer's PPD file
@@ -1075,4 +1768,17 @@ _brfCreateJobData(pappl_job_t *job,
  
   
   return (job_data);
+}
+
+
+//
+// '_brfDeleteJobData()' - Free the job data and everything allocated for it.
+//
+
+static void
+_brfDeleteJobData(
+    brf_job_data_t *job_data)		// I - Job data
+{
+  if (job_data)
+    brf_arena_delete(job_data->arena);
 }
\ No newline at end of file
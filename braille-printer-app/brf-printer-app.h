@@ -0,0 +1,81 @@
+//
+// Private header for the Braille Printer Application
+//
+// Copyright © 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+#ifndef BRF_PRINTER_APP_H
+#  define BRF_PRINTER_APP_H
+
+//
+// Include necessary headers...
+//
+
+#  include <pappl/pappl.h>
+#  include "brfscan.h"
+
+
+//
+// Types...
+//
+
+typedef struct brf_arena_s brf_arena_t;	// Per-job memory arena
+typedef struct brf_metrics_s brf_metrics_t;
+					// Instrumented filter chain
+
+
+//
+// Functions...
+//
+
+// brf-arena.c
+extern int	brf_arena_add_option(brf_arena_t *arena, const char *name, const char *value, int num_options, cups_option_t **options);
+extern void	*brf_arena_alloc(brf_arena_t *arena, size_t size);
+extern int	brf_arena_copy_options(brf_arena_t *arena, int num_options, cups_option_t *options, cups_option_t **copy);
+extern void	brf_arena_delete(brf_arena_t *arena);
+extern brf_arena_t *brf_arena_new(void);
+extern char	*brf_arena_strdup(brf_arena_t *arena, const char *s);
+
+// brf-estimate.c
+extern double	brf_estimate_job(pappl_job_t *job, pappl_pr_options_t *options, const brf_scan_t *scan);
+
+// brf-metrics.c
+extern cups_array_t *brf_metrics_chain(brf_metrics_t *metrics);
+extern void	brf_metrics_delete(brf_metrics_t *metrics, pappl_job_t *job);
+extern brf_metrics_t *brf_metrics_new(cups_array_t *chain);
+extern void	brf_metrics_register(pappl_system_t *system);
+
+// brf-mime.c
+extern const char *brf_mime_type(const unsigned char *header, size_t headersize);
+
+// brf-pool.c
+extern bool	brf_pool_print(pappl_job_t *job, pappl_pr_options_t *options, int fd, bool page_ranges);
+extern bool	brf_pool_printer(pappl_printer_t *printer);
+extern void	brf_pool_register(void);
+
+// brf-printer-app.c
+extern bool	brf_is_brf_format(const char *format);
+
+// brf-sched.c
+extern void	brf_sched_driver(pappl_pr_driver_data_t *driver_data, ipp_t **attrs);
+extern void	brf_sched_event(pappl_printer_t *printer, pappl_job_t *job, pappl_event_t event);
+extern void	brf_sched_register(pappl_system_t *system);
+
+// brf-spool.c
+extern void	brf_spool_close(int fd, size_t reserved);
+extern int	brf_spool_create(const char *name, size_t estimate, size_t *reserved);
+extern void	brf_spool_init(const char *dir, const char *megabytes);
+
+// generic-brf.c
+extern bool	brf_gen(pappl_system_t *system, const char *driver_name, const char *device_uri, const char *device_id, pappl_pr_driver_data_t *data, ipp_t **attrs, void *cbdata);
+
+// index-brf.c
+extern bool	brf_index(pappl_system_t *system, const char *driver_name, const char *device_uri, const char *device_id, pappl_pr_driver_data_t *data, ipp_t **attrs, void *cbdata);
+extern bool	brf_index_print_brf(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, int fd);
+extern bool	brf_index_print_part(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, int fd, off_t offset, off_t length);
+extern bool	brf_index_print_ubrl(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, int fd);
+
+#endif // !BRF_PRINTER_APP_H
@@ -0,0 +1,563 @@
+//
+// Job scheduling for the Braille Printer Application
+//
+// Copyright © 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// PAPPL processes the pending jobs of a printer in the order they were
+// submitted.  With the "shortest-first" policy every new job is held when it
+// becomes pending, and whenever the printer has no job to process the held
+// job with the lowest score is released: its estimated embossing time minus
+// the time it has waited, multiplied by the aging factor, so that a long job
+// is not postponed forever by short ones.  Jobs which cannot be estimated
+// before they are filtered are not held and keep their place in PAPPL's
+// queue.
+//
+// The event callback is called with the printer and job locked, so events
+// are only queued there; jobs are estimated, held and released by a
+// scheduler thread.
+//
+
+//
+// Include necessary headers...
+//
+
+#include <pappl/pappl.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "brf-printer-app.h"
+
+
+//
+// Constants...
+//
+
+#define BRF_SCHED_AGING		"2"	// Default aging factor
+
+
+//
+// Local types...
+//
+
+typedef struct brf_sched_event_s	// Queued event
+{
+  int			printer_id,	// Printer ID
+			job_id;		// Job ID or 0
+} brf_sched_event_t;
+
+typedef struct brf_sched_job_s		// Scheduled job
+{
+  int			printer_id,	// Printer ID
+			job_id;		// Job ID
+  char			printer[128];	// Printer name
+  double		seconds;	// Estimated embossing time, -1 if unknown
+  time_t		queued;		// Time the job was created
+  bool			held;		// Held by the scheduler?
+} brf_sched_job_t;
+
+
+//
+// Local globals...
+//
+
+static pthread_mutex_t	brf_sched_events_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// Mutex for the event queue
+static pthread_cond_t	brf_sched_events_cond = PTHREAD_COND_INITIALIZER;
+					// Event queued
+static int		brf_sched_num_events = 0,
+					// Number of queued events
+			brf_sched_alloc_events = 0;
+					// Allocated events
+static brf_sched_event_t *brf_sched_events = NULL;
+					// Queued events
+static pthread_mutex_t	brf_sched_jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// Mutex for the jobs, only the
+					// scheduler thread changes them
+static int		brf_sched_num_jobs = 0,
+					// Number of jobs
+			brf_sched_alloc_jobs = 0;
+					// Allocated jobs
+static brf_sched_job_t	*brf_sched_jobs = NULL;
+					// Jobs known to the scheduler
+static pappl_system_t	*brf_sched_system = NULL;
+					// System
+
+
+//
+// Local functions...
+//
+
+static double	brf_sched_estimate(pappl_job_t *job);
+static brf_sched_job_t *brf_sched_find(int job_id);
+static void	brf_sched_next(pappl_printer_t *printer);
+static bool	brf_sched_page(pappl_client_t *client, void *data);
+static bool	brf_sched_policy(pappl_printer_t *printer, int *aging);
+static void	brf_sched_remove(brf_sched_job_t *sj);
+static void	*brf_sched_run(void *data);
+static void	brf_sched_update(pappl_printer_t *printer, int job_id);
+
+
+//
+// 'brf_sched_driver()' - Add the scheduling options to a driver.
+//
+// They are vendor options so that they show up with the printing defaults
+// in the web interface and are saved with the printer.
+//
+
+void
+brf_sched_driver(
+    pappl_pr_driver_data_t *driver_data,// I - Driver data
+    ipp_t                  **attrs)	// IO - Driver attributes
+{
+  static const char * const policies[] =// job-scheduling values
+  {
+    "shortest-first",
+    "first-come-first-served"
+  };
+  static const char * const agings[] =	// job-aging values
+  {
+    "1",
+    "2",
+    "4",
+    "8"
+  };
+
+
+  if (!*attrs)
+    *attrs = ippNew();
+
+  driver_data->vendor[driver_data->num_vendor ++] = "job-scheduling";
+  ippAddStrings(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "job-scheduling-supported", (int)(sizeof(policies) / sizeof(policies[0])), NULL, policies);
+  ippAddString(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "job-scheduling-default", NULL, policies[0]);
+
+  driver_data->vendor[driver_data->num_vendor ++] = "job-aging";
+  ippAddStrings(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "job-aging-supported", (int)(sizeof(agings) / sizeof(agings[0])), NULL, agings);
+  ippAddString(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "job-aging-default", NULL, BRF_SCHED_AGING);
+}
+
+
+//
+// 'brf_sched_event()' - Queue an event for the scheduler.
+//
+// Called from the event callback, with the printer and job locked: only
+// their IDs are used here.
+//
+
+void
+brf_sched_event(
+    pappl_printer_t *printer,		// I - Printer, if any
+    pappl_job_t     *job,		// I - Job, if any
+    pappl_event_t   event)		// I - Event
+{
+  brf_sched_event_t	*temp;		// New events array
+
+
+  if (!printer || !brf_sched_system || !(event & (PAPPL_EVENT_JOB_COMPLETED | PAPPL_EVENT_JOB_STATE_CHANGED | PAPPL_EVENT_PRINTER_CONFIG_CHANGED)))
+    return;
+
+  pthread_mutex_lock(&brf_sched_events_mutex);
+
+  if (brf_sched_num_events >= brf_sched_alloc_events)
+  {
+    if ((temp = (brf_sched_event_t *)realloc(brf_sched_events, (size_t)(brf_sched_alloc_events + 64) * sizeof(brf_sched_event_t))) == NULL)
+    {
+      pthread_mutex_unlock(&brf_sched_events_mutex);
+      return;
+    }
+
+    brf_sched_events       = temp;
+    brf_sched_alloc_events += 64;
+  }
+
+  brf_sched_events[brf_sched_num_events].printer_id = papplPrinterGetID(printer);
+  brf_sched_events[brf_sched_num_events].job_id     = job ? papplJobGetID(job) : 0;
+  brf_sched_num_events ++;
+
+  pthread_cond_signal(&brf_sched_events_cond);
+  pthread_mutex_unlock(&brf_sched_events_mutex);
+}
+
+
+//
+// 'brf_sched_register()' - Start the scheduler and add its page to the web
+//                          server.
+//
+
+void
+brf_sched_register(
+    pappl_system_t *system)		// I - System
+{
+  pthread_t	tid;			// Scheduler thread
+  int		error;			// Thread creation error
+
+
+  brf_sched_system = system;
+
+  if ((error = pthread_create(&tid, NULL, brf_sched_run, NULL)) != 0)
+  {
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to start job scheduler: %s", strerror(error));
+    brf_sched_system = NULL;
+    return;
+  }
+
+  pthread_detach(tid);
+
+  papplSystemAddResourceCallback(system, "/schedule", "text/plain", brf_sched_page, NULL);
+}
+
+
+//
+// 'brf_sched_estimate()' - Estimate the embossing time of a job.
+//
+// BRF and plain text are scanned like the drivers do.  The page count of
+// other formats is only known once the filter chain has translated them, so
+// they are not estimated.  The estimate is also shown as the job message.
+//
+
+static double				// O - Seconds or -1 if unknown
+brf_sched_estimate(pappl_job_t *job)	// I - Job
+{
+  pappl_pr_options_t	*options;	// Job options
+  const char		*format = papplJobGetFormat(job);
+					// Document format
+  int			fd;		// Document file
+  char			buffer[65536];	// Read buffer
+  ssize_t		bytes;		// Bytes read
+  brf_scan_t		scan;		// Document statistics
+  double		seconds;	// Estimate
+
+
+  if (!brf_is_brf_format(format) && (!format || strcmp(format, "text/plain")))
+    return (-1.0);
+
+  if ((fd = open(papplJobGetFilename(job), O_RDONLY)) < 0)
+    return (-1.0);
+
+  brf_scan_init(&scan);
+  while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
+    brf_scan_data(&scan, buffer, (size_t)bytes);
+  brf_scan_finish(&scan);
+
+  close(fd);
+
+  options = papplJobCreatePrintOptions(job, INT_MAX, false);
+  seconds = brf_estimate_job(job, options, &scan);
+  papplJobDeletePrintOptions(options);
+
+  return (seconds);
+}
+
+
+//
+// 'brf_sched_find()' - Find a scheduled job.
+//
+
+static brf_sched_job_t *		// O - Job or `NULL`
+brf_sched_find(int job_id)		// I - Job ID
+{
+  int	i;				// Looping var
+
+
+  for (i = 0; i < brf_sched_num_jobs; i ++)
+  {
+    if (brf_sched_jobs[i].job_id == job_id)
+      return (brf_sched_jobs + i);
+  }
+
+  return (NULL);
+}
+
+
+//
+// 'brf_sched_next()' - Release the next job of a printer when it has none
+//                      to process.
+//
+
+static void
+brf_sched_next(
+    pappl_printer_t *printer)		// I - Printer
+{
+  int			printer_id = papplPrinterGetID(printer);
+					// Printer ID
+  int			i,		// Looping var
+			aging;		// Aging factor
+  bool			shortest;	// Shortest job first?
+  brf_sched_job_t	*sj,		// Current job
+			*best;		// Job to release
+  pappl_job_t		*job;		// PAPPL job
+  ipp_jstate_t		state;		// Job state
+  double		score,		// Score of current job
+			best_score = 0.0;// Score of best job
+  time_t		now = time(NULL);
+					// Current time
+
+
+  shortest = brf_sched_policy(printer, &aging);
+
+  for (;;)
+  {
+    // Only one job is released at a time, unless the policy has been changed
+    for (i = 0, sj = brf_sched_jobs, best = NULL; i < brf_sched_num_jobs; i ++, sj ++)
+    {
+      if (sj->printer_id != printer_id)
+        continue;
+
+      if (!sj->held)
+      {
+        if ((job = papplPrinterFindJob(printer, sj->job_id)) != NULL && ((state = papplJobGetState(job)) == IPP_JSTATE_PENDING || state == IPP_JSTATE_PROCESSING || state == IPP_JSTATE_STOPPED) && shortest)
+          return;
+        continue;
+      }
+
+      score = sj->seconds - (double)aging * (double)(now - sj->queued);
+
+      if (!best || score < best_score || (score == best_score && sj->job_id < best->job_id))
+      {
+        best       = sj;
+        best_score = score;
+      }
+    }
+
+    if (!best)
+      return;
+
+    pthread_mutex_lock(&brf_sched_jobs_mutex);
+    best->held = false;
+    pthread_mutex_unlock(&brf_sched_jobs_mutex);
+
+    if ((job = papplPrinterFindJob(printer, best->job_id)) != NULL && papplJobRelease(job, NULL))
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Scheduled, estimated %.0f seconds, waited %ld seconds.", best->seconds, (long)(now - best->queued));
+
+      if (shortest)
+        return;
+    }
+  }
+}
+
+
+//
+// 'brf_sched_page()' - Show the scheduled jobs.
+//
+
+static bool				// O - `true` on success
+brf_sched_page(
+    pappl_client_t *client,		// I - Client
+    void           *data)		// I - Callback data (unused)
+{
+  int			i;		// Looping var
+  brf_sched_job_t	*sj;		// Current job
+  time_t		now = time(NULL);
+					// Current time
+
+
+  (void)data;
+
+  if (!papplClientRespond(client, HTTP_STATUS_OK, NULL, "text/plain", 0, 0))
+    return (false);
+
+  pthread_mutex_lock(&brf_sched_jobs_mutex);
+
+  papplClientPrintf(client, "# Braille Printer Application job schedule\n");
+
+  for (i = 0, sj = brf_sched_jobs; i < brf_sched_num_jobs; i ++, sj ++)
+  {
+    if (sj->seconds >= 0.0)
+      papplClientPrintf(client, "brf_job_estimate_seconds{printer=\"%s\",job=\"%d\"} %.0f\n", sj->printer, sj->job_id, sj->seconds);
+    papplClientPrintf(client, "brf_job_wait_seconds{printer=\"%s\",job=\"%d\"} %ld\n", sj->printer, sj->job_id, (long)(now - sj->queued));
+    papplClientPrintf(client, "brf_job_held{printer=\"%s\",job=\"%d\"} %d\n", sj->printer, sj->job_id, sj->held ? 1 : 0);
+  }
+
+  pthread_mutex_unlock(&brf_sched_jobs_mutex);
+
+  return (true);
+}
+
+
+//
+// 'brf_sched_policy()' - Get the scheduling policy of a printer.
+//
+
+static bool				// O - `true` for shortest first
+brf_sched_policy(
+    pappl_printer_t *printer,		// I - Printer
+    int             *aging)		// O - Aging factor
+{
+  ipp_t			*attrs;		// Driver attributes
+  ipp_attribute_t	*attr;		// Current attribute
+  bool			shortest = true;// Shortest first?
+
+
+  *aging = atoi(BRF_SCHED_AGING);
+
+  if ((attrs = papplPrinterGetDriverAttributes(printer)) != NULL)
+  {
+    if ((attr = ippFindAttribute(attrs, "job-scheduling-default", IPP_TAG_KEYWORD)) != NULL)
+      shortest = strcmp(ippGetString(attr, 0, NULL), "first-come-first-served") != 0;
+
+    if ((attr = ippFindAttribute(attrs, "job-aging-default", IPP_TAG_KEYWORD)) != NULL && atoi(ippGetString(attr, 0, NULL)) > 0)
+      *aging = atoi(ippGetString(attr, 0, NULL));
+
+    ippDelete(attrs);
+  }
+
+  return (shortest);
+}
+
+
+//
+// 'brf_sched_remove()' - Forget a job.
+//
+
+static void
+brf_sched_remove(brf_sched_job_t *sj)	// I - Job
+{
+  pthread_mutex_lock(&brf_sched_jobs_mutex);
+
+  brf_sched_num_jobs --;
+  memmove(sj, sj + 1, (size_t)(brf_sched_jobs + brf_sched_num_jobs - sj) * sizeof(brf_sched_job_t));
+
+  pthread_mutex_unlock(&brf_sched_jobs_mutex);
+}
+
+
+//
+// 'brf_sched_run()' - Handle the queued events.
+//
+
+static void *				// O - Thread exit status (unused)
+brf_sched_run(void *data)		// I - Thread data (unused)
+{
+  brf_sched_event_t	*events;	// Events to handle
+  int			num_events,	// Number of events
+			i, j;		// Looping vars
+  pappl_printer_t	*printer;	// Printer
+
+
+  (void)data;
+
+  for (;;)
+  {
+    pthread_mutex_lock(&brf_sched_events_mutex);
+    while (brf_sched_num_events == 0)
+      pthread_cond_wait(&brf_sched_events_cond, &brf_sched_events_mutex);
+
+    events                 = brf_sched_events;
+    num_events             = brf_sched_num_events;
+    brf_sched_events       = NULL;
+    brf_sched_num_events   = 0;
+    brf_sched_alloc_events = 0;
+    pthread_mutex_unlock(&brf_sched_events_mutex);
+
+    // The PAPPL functions called here may queue more events, so no mutex is
+    // held while calling them
+    for (i = 0; i < num_events; i ++)
+    {
+      if ((printer = papplSystemFindPrinter(brf_sched_system, NULL, events[i].printer_id, NULL)) == NULL)
+      {
+        // Printer deleted
+        for (j = brf_sched_num_jobs - 1; j >= 0; j --)
+        {
+          if (brf_sched_jobs[j].printer_id == events[i].printer_id)
+            brf_sched_remove(brf_sched_jobs + j);
+        }
+        continue;
+      }
+
+      if (events[i].job_id)
+        brf_sched_update(printer, events[i].job_id);
+
+      brf_sched_next(printer);
+    }
+
+    free(events);
+  }
+
+  return (NULL);
+}
+
+
+//
+// 'brf_sched_update()' - Update a job after an event.
+//
+
+static void
+brf_sched_update(
+    pappl_printer_t *printer,		// I - Printer
+    int             job_id)		// I - Job ID
+{
+  pappl_job_t		*job;		// PAPPL job
+  ipp_jstate_t		state;		// Job state
+  brf_sched_job_t	*sj,		// Scheduled job
+			*temp;		// New jobs array
+  int			aging;		// Aging factor (unused)
+  double		seconds;	// Estimate
+
+
+  job   = papplPrinterFindJob(printer, job_id);
+  state = job ? papplJobGetState(job) : IPP_JSTATE_COMPLETED;
+
+  if ((sj = brf_sched_find(job_id)) != NULL)
+  {
+    if (state >= IPP_JSTATE_CANCELED)
+    {
+      brf_sched_remove(sj);
+    }
+    else if (sj->held && state != IPP_JSTATE_HELD)
+    {
+      // Released or started by someone else, it is no longer ours
+      pthread_mutex_lock(&brf_sched_jobs_mutex);
+      sj->held = false;
+      pthread_mutex_unlock(&brf_sched_jobs_mutex);
+    }
+    return;
+  }
+
+  // New jobs are seen once their document has been received, jobs held by
+  // their owners once they are released
+  if (state != IPP_JSTATE_PENDING && state != IPP_JSTATE_PROCESSING)
+    return;
+
+  // Processing jobs are not scheduled, and have their own progress message
+  seconds = state == IPP_JSTATE_PENDING ? brf_sched_estimate(job) : 0.0;
+
+  pthread_mutex_lock(&brf_sched_jobs_mutex);
+
+  if (brf_sched_num_jobs >= brf_sched_alloc_jobs)
+  {
+    if ((temp = (brf_sched_job_t *)realloc(brf_sched_jobs, (size_t)(brf_sched_alloc_jobs + 64) * sizeof(brf_sched_job_t))) == NULL)
+    {
+      pthread_mutex_unlock(&brf_sched_jobs_mutex);
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate memory for scheduling: %s", strerror(errno));
+      return;
+    }
+
+    brf_sched_jobs       = temp;
+    brf_sched_alloc_jobs += 64;
+  }
+
+  sj = brf_sched_jobs + brf_sched_num_jobs ++;
+
+  memset(sj, 0, sizeof(brf_sched_job_t));
+  sj->printer_id = papplPrinterGetID(printer);
+  sj->job_id     = job_id;
+  sj->seconds    = seconds;
+  sj->queued     = papplJobGetTimeCreated(job);
+  papplCopyString(sj->printer, papplPrinterGetName(printer), sizeof(sj->printer));
+
+  pthread_mutex_unlock(&brf_sched_jobs_mutex);
+
+  // Hold it until it is its turn, jobs without an estimate are processed in
+  // the order they were submitted...
+  if (state == IPP_JSTATE_PENDING && seconds >= 0.0 && brf_sched_policy(printer, &aging) && papplJobHold(job, NULL, "indefinite", 0))
+  {
+    pthread_mutex_lock(&brf_sched_jobs_mutex);
+    sj->held = true;
+    pthread_mutex_unlock(&brf_sched_jobs_mutex);
+  }
+}
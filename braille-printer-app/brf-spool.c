@@ -0,0 +1,129 @@
+//
+// Memory spool for the Braille Printer Application
+//
+// Copyright © 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Temporary job data, the translated BRF of a job sent to an embosser pool,
+// is written to a memfd_create() file when it fits in a budget, set with the
+// "spool-memory" server option.  The size of the data is not known before it
+// is written, so the size of the job document is counted against the budget
+// when the file is created; a job for which it does not fit goes to an
+// unlinked file in the spool directory.  The budget is not enforced while the
+// data is written, a memory file may grow beyond its estimate.  Where
+// memfd_create() is not available everything goes to the spool directory.
+//
+// Job documents are spooled by PAPPL and are not handled here.
+//
+
+//
+// Include necessary headers...
+//
+
+#include <pappl/pappl.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "brf-printer-app.h"
+
+
+//
+// Constants...
+//
+
+#define BRF_SPOOL_MEMORY	64	// Default budget in megabytes
+
+
+//
+// Local globals...
+//
+
+static pthread_mutex_t	brf_spool_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// Mutex for the budget
+static char		brf_spool_dir[1024] = "/tmp";
+					// Spool directory
+static size_t		brf_spool_budget = (size_t)BRF_SPOOL_MEMORY * 1024 * 1024,
+					// Memory budget
+			brf_spool_used = 0;
+					// Memory used
+
+
+//
+// 'brf_spool_close()' - Close spooled data and give its memory back.
+//
+
+void
+brf_spool_close(int    fd,		// I - Spool file
+                size_t reserved)	// I - Bytes counted against the budget
+{
+  close(fd);
+
+  pthread_mutex_lock(&brf_spool_mutex);
+  brf_spool_used -= reserved;
+  pthread_mutex_unlock(&brf_spool_mutex);
+}
+
+
+//
+// 'brf_spool_create()' - Create a spool file for temporary job data.
+//
+
+int					// O - Spool file or -1 on error
+brf_spool_create(const char *name,	// I - Name of the data
+                 size_t     estimate,	// I - Expected size in bytes
+                 size_t     *reserved)	// O - Bytes counted against the budget
+{
+  int	fd = -1;			// Spool file
+  char	filename[2048];			// Spool file name
+  bool	fits;				// Does the data fit in the budget?
+
+
+  *reserved = 0;
+
+#ifdef MFD_CLOEXEC
+  pthread_mutex_lock(&brf_spool_mutex);
+  if ((fits = brf_spool_budget > 0 && brf_spool_used + estimate <= brf_spool_budget) == true)
+  {
+    brf_spool_used += estimate;
+    *reserved      = estimate;
+  }
+  pthread_mutex_unlock(&brf_spool_mutex);
+
+  if (fits)
+  {
+    if ((fd = memfd_create(name, MFD_CLOEXEC)) >= 0)
+      return (fd);
+
+    pthread_mutex_lock(&brf_spool_mutex);
+    brf_spool_used -= *reserved;
+    pthread_mutex_unlock(&brf_spool_mutex);
+
+    *reserved = 0;
+  }
+#endif // MFD_CLOEXEC
+
+  snprintf(filename, sizeof(filename), "%s/%s-XXXXXX", brf_spool_dir, name);
+  if ((fd = mkostemp(filename, O_CLOEXEC)) >= 0)
+    unlink(filename);
+
+  return (fd);
+}
+
+
+//
+// 'brf_spool_init()' - Set the spool directory and memory budget.
+//
+
+void
+brf_spool_init(const char *dir,		// I - Spool directory
+               const char *megabytes)	// I - Memory budget in megabytes or `NULL` for the default
+{
+  papplCopyString(brf_spool_dir, dir, sizeof(brf_spool_dir));
+
+  if (megabytes)
+    brf_spool_budget = (size_t)strtoul(megabytes, NULL, 10) * 1024 * 1024;
+}
@@ -5,6 +5,7 @@
 //
 
 #include <pappl/pappl.h>
+#include "brf-printer-app.h"
 #include<math.h>
 
 //
@@ -58,7 +59,10 @@ brf_gen(
   driver_data->rstartpage_cb = brf_gen_rstartpage;
   driver_data->rwriteline_cb = brf_gen_rwriteline;
   driver_data->status_cb     = brf_gen_status;
-  driver_data->format        = "application/vnd.cups-paged-brf";
+  if (!strcmp(driver_name, "gen_ubrl"))
+    driver_data->format      = "application/vnd.cups-paged-ubrl";
+  else
+    driver_data->format      = "application/vnd.cups-paged-brf";
 
   driver_data->num_resolution = 1;
   driver_data->x_resolution[0] = 200;
@@ -121,9 +125,9 @@ brf_gen_printfile(
   int		fd;			// Input file
   ssize_t	bytes;			// Bytes read/written
   char		buffer[65536];		// Read/write buffer
+  brf_scan_t	scan;			// Page counts
 
 
-  // Copy the raw file...
   papplJobSetImpressions(job, 1);
 
   if ((fd  = open(papplJobGetFilename(job), O_RDONLY)) < 0)
@@ -132,6 +136,26 @@ brf_gen_printfile(
     return (false);
   }
 
+  if (brf_pool_printer(papplJobGetPrinter(job)))
+  {
+    // Split among the members of the pool
+    bool ret = brf_pool_print(job, options, fd, true);
+					// Return value
+
+    close(fd);
+    return (ret);
+  }
+
+  // Estimate pages and embossing time...
+  brf_scan_init(&scan);
+  while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
+    brf_scan_data(&scan, buffer, (size_t)bytes);
+  brf_scan_finish(&scan);
+
+  brf_estimate_job(job, options, &scan);
+  lseek(fd, 0, SEEK_SET);
+
+  // Copy the raw file...
   while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
   {
     if (papplDeviceWrite(device, buffer, (size_t)bytes) < 0)
@@ -143,7 +167,7 @@ brf_gen_printfile(
   }
   close(fd);
 
-  papplJobSetImpressionsCompleted(job, 1);
+  papplJobSetImpressionsCompleted(job, papplJobGetImpressions(job));
 
   return (true);
 }
@@ -0,0 +1,1364 @@
+//
+// Index V3/V4 embosser driver for the Braille Printer Application
+//
+// Copyright © 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// This is a native port of the textbrftoindexv3/v4 and imageubrltoindexv3/v4
+// CUPS filters: the INIT escape sequence is built from the driver attributes
+// and text/graphics are encoded in-process.
+//
+
+//
+// Include necessary headers...
+//
+
+#include <pappl/pappl.h>
+#include "brf-printer-app.h"
+#include <limits.h>
+
+
+//
+// Local types...
+//
+
+typedef enum brf_index_gen_e		// Index protocol generation
+{
+  BRF_INDEX_V3,				// V3 (PW/PL paper size, LS0-LS8)
+  BRF_INDEX_V4				// V4/V5 (CH/LP paper size, LS50/LS100)
+} brf_index_gen_t;
+
+typedef enum brf_index_length_e		// Paper length unit (IndexPaperLength)
+{
+  BRF_INDEX_LENGTH_NONE,		// Do not send PW/PL
+  BRF_INDEX_LENGTH_IN,			// Inches
+  BRF_INDEX_LENGTH_MM			// Millimeters
+} brf_index_length_t;
+
+typedef struct brf_index_model_s	// Index model data (from drv/index*.drv)
+{
+  const char		*name;		// Driver name
+  brf_index_gen_t	gen;		// Protocol generation
+  int			max_width;	// Maximum paper width in 1/100 mm
+  bool			duplex,		// Double-sided printing?
+			z_folding,	// Z-folding?
+			sideways,	// Sideways folding?
+			saddle_stitch;	// Saddle stitch?
+  brf_index_length_t	paper_length;	// Unit for PW/PL
+  int			margins[4];	// HW margins (left, bottom, right, top)
+					// in 1/100 mm
+} brf_index_model_t;
+
+typedef struct brf_index_job_s		// Per-job embossing parameters
+{
+  const brf_index_model_t *model;	// Model
+  char			init[256];	// INIT escape sequence
+  bool			translated;	// Software-translated BRF?
+} brf_index_job_t;
+
+typedef struct brf_index_in_s		// Document input
+{
+  int			fd;		// Input file
+  off_t			offset,		// Next byte of the part
+			remaining;	// Bytes left in the part, -1 for all
+} brf_index_in_t;
+
+typedef struct brf_index_out_s		// Buffered device output
+{
+  pappl_device_t	*device;	// Output device
+  size_t		used;		// Bytes in buffer
+  bool			error;		// Did a write fail?
+  unsigned char		buffer[16384];	// Output buffer
+} brf_index_out_t;
+
+
+//
+// Local functions...
+//
+
+static bool	brf_index_init(pappl_job_t *job, pappl_pr_options_t *options, brf_index_job_t *ij);
+static void	brf_index_out(brf_index_out_t *out, const void *data, size_t len);
+static void	brf_index_out_flush(brf_index_out_t *out);
+static ssize_t	brf_index_read(brf_index_in_t *in, void *buffer, size_t bufsize);
+static bool	brf_index_send_brf(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, brf_index_in_t *in);
+static bool	brf_index_printfile(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
+static bool	brf_index_rendjob(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
+static bool	brf_index_rendpage(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned page);
+static bool	brf_index_rstartjob(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
+static bool	brf_index_rstartpage(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned page);
+static bool	brf_index_rwriteline(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned y, const unsigned char *line);
+static bool	brf_index_status(pappl_printer_t *printer);
+static const char *brf_index_vendor(pappl_pr_options_t *options, const char *name, const char *defval);
+static void	brf_index_mm_to_in(int mm, char *buffer, size_t bufsize);
+
+
+//
+// Local globals...
+//
+
+static const brf_index_model_t brf_index_models[] =
+{					// Models from drv/indexv3.drv and
+					// drv/indexv4.drv
+  { "indexv3_basicd",   BRF_INDEX_V3, 32500, true,  true,  false, false, BRF_INDEX_LENGTH_IN,   { 0, 500, 0, 200 } },
+  { "indexv3_basics",   BRF_INDEX_V3, 32500, false, false, false, false, BRF_INDEX_LENGTH_IN,   { 0, 500, 0, 200 } },
+  { "indexv3_4waves",   BRF_INDEX_V3, 32500, true,  true,  false, false, BRF_INDEX_LENGTH_NONE, { 0, 500, 0, 200 } },
+  { "indexv3_everestd", BRF_INDEX_V3, 29700, true,  false, false, false, BRF_INDEX_LENGTH_MM,   { 0, 500, 0, 200 } },
+  { "indexv3_4x4pro",   BRF_INDEX_V3, 29700, true,  false, false, true,  BRF_INDEX_LENGTH_MM,   { 0, 500, 0, 200 } },
+  { "indexv4_basicd",   BRF_INDEX_V4, 32500, true,  true,  true,  false, BRF_INDEX_LENGTH_NONE, { 500, 500, 500, 500 } },
+  { "indexv4_basics",   BRF_INDEX_V4, 32500, false, false, false, false, BRF_INDEX_LENGTH_NONE, { 500, 500, 500, 500 } },
+  { "indexv4_everestd", BRF_INDEX_V4, 29700, true,  false, false, true,  BRF_INDEX_LENGTH_NONE, { 500, 500, 500, 500 } },
+  { "indexv4_brlbox",   BRF_INDEX_V4, 29700, true,  false, false, true,  BRF_INDEX_LENGTH_NONE, { 500, 500, 500, 500 } }
+};
+
+static const struct			// Supported media sizes (media-braille.defs)
+{
+  const char	*pwg;			// PWG media name
+  int		width;			// Width in 1/100 mm
+} brf_index_media[] =
+{
+  { "na_legal_8.5x14in",          21590 },
+  { "na_letter_8.5x11in",         21590 },
+  { "iso_a3_297x420mm",           29700 },
+  { "iso_a4_210x297mm",           21000 },
+  { "om_a4-tractor_210x304.8mm",  21000 },
+  { "iso_a5_148x210mm",           14850 },
+  { "oe_11x11.5_11x11.5in",       27940 },
+  { "oe_11x12_11x12in",           27940 },
+  { "na_ledger_11x17in",          27940 },
+  { "oe_11.5x11_11.5x11in",       29210 },
+  { "oe_12x12_12x12in",           30480 }
+};
+
+static const unsigned char brf_index_6dots[64] =
+{					// North American BRF (0x20-0x5f) to
+					// Index transparent mode 6-dot codes
+  0x00, 0x56, 0x20, 0x74, 0x53, 0x51, 0x57, 0x04,
+  0x67, 0x76, 0x41, 0x54, 0x40, 0x44, 0x50, 0x14,
+  0x64, 0x02, 0x06, 0x22, 0x62, 0x42, 0x26, 0x66,
+  0x46, 0x24, 0x61, 0x60, 0x43, 0x77, 0x34, 0x71,
+  0x10, 0x01, 0x03, 0x11, 0x31, 0x21, 0x13, 0x33,
+  0x23, 0x12, 0x32, 0x05, 0x07, 0x15, 0x35, 0x25,
+  0x17, 0x37, 0x27, 0x16, 0x36, 0x45, 0x47, 0x72,
+  0x55, 0x75, 0x65, 0x52, 0x63, 0x73, 0x30, 0x70
+};
+
+static const char * const brf_index_v3_spacing[] =
+{					// V3 line spacings
+  "250", "375", "450", "475", "500", "525", "550", "750", "1000"
+};
+
+static const char * const brf_index_v4_spacing[] =
+{					// V4 line spacings
+  "500", "1000"
+};
+
+static const char * const brf_index_v3_tables[] =
+{					// V3 firmware braille tables
+  "0", "1", "2", "3", "4"
+};
+
+static const char * const brf_index_v4_tables[] =
+{					// V4 firmware braille tables
+  "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15", "16", "17",
+  "18", "19", "20", "21", "22", "23", "24", "25", "26"
+};
+
+
+//
+// 'brf_index()' - Set up the driver data for an Index embosser.
+//
+
+bool					// O - `true` on success, `false` on error
+brf_index(
+    pappl_system_t         *system,	// I - System
+    const char             *driver_name,// I - Driver name
+    const char             *device_uri,	// I - Device URI
+    const char             *device_id,	// I - 1284 device ID
+    pappl_pr_driver_data_t *driver_data,// I - Pointer to driver data
+    ipp_t                  **attrs,	// O - Pointer to driver attributes
+    void                   *cbdata)	// I - Callback data (not used)
+{
+  int				i;	// Looping var
+  const brf_index_model_t	*model = NULL;
+					// Model data
+  static const char * const firmware_v3[] =
+  {					// V3 firmware versions
+    "102000", "103000", "120130"
+  };
+  static const char * const firmware_v4[] =
+  {					// V4 firmware versions
+    "102000", "103000"
+  };
+  static const char * const text_dot_distances[] =
+  {					// Text dot distances
+    "220", "250", "320"
+  };
+  static const char * const text_dots[] =
+  {					// Text dots
+    "6", "8"
+  };
+  static const char * const graphic_dot_distances[] =
+  {					// Graphic dot distances
+    "160", "200", "250"
+  };
+  static const char * const multiple_impacts[] =
+  {					// Multiple impact values
+    "1", "2", "3"
+  };
+
+
+  (void)system;
+  (void)device_uri;
+  (void)device_id;
+  (void)cbdata;
+
+  for (i = 0; i < (int)(sizeof(brf_index_models) / sizeof(brf_index_models[0])); i ++)
+  {
+    if (!strcmp(driver_name, brf_index_models[i].name))
+    {
+      model = brf_index_models + i;
+      break;
+    }
+  }
+
+  if (!model)
+    return (false);
+
+  driver_data->extension     = (void *)model;
+  driver_data->printfile_cb  = brf_index_printfile;
+  driver_data->rendjob_cb    = brf_index_rendjob;
+  driver_data->rendpage_cb   = brf_index_rendpage;
+  driver_data->rstartjob_cb  = brf_index_rstartjob;
+  driver_data->rstartpage_cb = brf_index_rstartpage;
+  driver_data->rwriteline_cb = brf_index_rwriteline;
+  driver_data->status_cb     = brf_index_status;
+  driver_data->format        = "application/vnd.cups-paged-brf";
+
+  driver_data->num_resolution  = 1;
+  driver_data->x_resolution[0] = 200;
+  driver_data->y_resolution[0] = 200;
+  driver_data->x_default = driver_data->y_default = driver_data->x_resolution[0];
+
+  // Media that fits the model...
+  for (i = 0, driver_data->num_media = 0; i < (int)(sizeof(brf_index_media) / sizeof(brf_index_media[0])); i ++)
+  {
+    if (brf_index_media[i].width <= model->max_width)
+      driver_data->media[driver_data->num_media ++] = brf_index_media[i].pwg;
+  }
+
+  driver_data->left_right = model->margins[0] > model->margins[2] ? model->margins[0] : model->margins[2];
+  driver_data->bottom_top = model->margins[1] > model->margins[3] ? model->margins[1] : model->margins[3];
+
+  papplCopyString(driver_data->media_default.size_name, "om_a4-tractor_210x304.8mm", sizeof(driver_data->media_default.size_name));
+  driver_data->media_default.size_width    = 21000;
+  driver_data->media_default.size_length   = 30480;
+  driver_data->media_default.bottom_margin = driver_data->bottom_top;
+  driver_data->media_default.left_margin   = driver_data->left_right;
+  driver_data->media_default.right_margin  = driver_data->left_right;
+  driver_data->media_default.top_margin    = driver_data->bottom_top;
+
+  driver_data->num_source = 1;
+  driver_data->source[0]  = "tractor";
+  papplCopyString(driver_data->media_default.source, "tractor", sizeof(driver_data->media_default.source));
+
+  driver_data->num_type = 1;
+  driver_data->type[0]  = "stationery";
+  papplCopyString(driver_data->media_default.type, "stationery", sizeof(driver_data->media_default.type));
+
+  driver_data->media_ready[0] = driver_data->media_default;
+
+  if (model->duplex)
+    driver_data->sides_supported = PAPPL_SIDES_ONE_SIDED | PAPPL_SIDES_TWO_SIDED_LONG_EDGE;
+
+  // Vendor options, matching the PPD options of the CUPS driver...
+  if (!*attrs)
+    *attrs = ippNew();
+
+  driver_data->num_vendor = 0;
+
+  driver_data->vendor[driver_data->num_vendor ++] = "index-firmware-version";
+  if (model->gen == BRF_INDEX_V3)
+    ippAddStrings(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "index-firmware-version-supported", (int)(sizeof(firmware_v3) / sizeof(firmware_v3[0])), NULL, firmware_v3);
+  else
+    ippAddStrings(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "index-firmware-version-supported", (int)(sizeof(firmware_v4) / sizeof(firmware_v4[0])), NULL, firmware_v4);
+  ippAddString(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "index-firmware-version-default", NULL, "103000");
+
+  driver_data->vendor[driver_data->num_vendor ++] = "index-table";
+  if (model->gen == BRF_INDEX_V3)
+  {
+    ippAddStrings(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "index-table-supported", (int)(sizeof(brf_index_v3_tables) / sizeof(brf_index_v3_tables[0])), NULL, brf_index_v3_tables);
+    ippAddString(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "index-table-default", NULL, brf_index_v3_tables[0]);
+  }
+  else
+  {
+    ippAddStrings(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "index-table-supported", (int)(sizeof(brf_index_v4_tables) / sizeof(brf_index_v4_tables[0])), NULL, brf_index_v4_tables);
+    ippAddString(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "index-table-default", NULL, brf_index_v4_tables[0]);
+  }
+
+  driver_data->vendor[driver_data->num_vendor ++] = "multiple-impact";
+  ippAddStrings(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "multiple-impact-supported", (int)(sizeof(multiple_impacts) / sizeof(multiple_impacts[0])), NULL, multiple_impacts);
+  ippAddString(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "multiple-impact-default", NULL, "1");
+
+  driver_data->vendor[driver_data->num_vendor ++] = "text-dot-distance";
+  ippAddStrings(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "text-dot-distance-supported", (int)(sizeof(text_dot_distances) / sizeof(text_dot_distances[0])), NULL, text_dot_distances);
+  ippAddString(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "text-dot-distance-default", NULL, "250");
+
+  driver_data->vendor[driver_data->num_vendor ++] = "text-dots";
+  ippAddStrings(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "text-dots-supported", (int)(sizeof(text_dots) / sizeof(text_dots[0])), NULL, text_dots);
+  ippAddString(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "text-dots-default", NULL, "6");
+
+  driver_data->vendor[driver_data->num_vendor ++] = "line-spacing";
+  if (model->gen == BRF_INDEX_V3)
+    ippAddStrings(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "line-spacing-supported", (int)(sizeof(brf_index_v3_spacing) / sizeof(brf_index_v3_spacing[0])), NULL, brf_index_v3_spacing);
+  else
+    ippAddStrings(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "line-spacing-supported", (int)(sizeof(brf_index_v4_spacing) / sizeof(brf_index_v4_spacing[0])), NULL, brf_index_v4_spacing);
+  ippAddString(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "line-spacing-default", NULL, "500");
+
+  driver_data->vendor[driver_data->num_vendor ++] = "graphic-dot-distance";
+  ippAddStrings(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "graphic-dot-distance-supported", (int)(sizeof(graphic_dot_distances) / sizeof(graphic_dot_distances[0])), NULL, graphic_dot_distances);
+  ippAddString(*attrs, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "graphic-dot-distance-default", NULL, "200");
+
+  driver_data->vendor[driver_data->num_vendor ++] = "software-translated";
+  ippAddBoolean(*attrs, IPP_TAG_PRINTER, "software-translated-supported", 1);
+  ippAddBoolean(*attrs, IPP_TAG_PRINTER, "software-translated-default", 1);
+
+  if (model->z_folding)
+  {
+    driver_data->vendor[driver_data->num_vendor ++] = "z-folding";
+    ippAddBoolean(*attrs, IPP_TAG_PRINTER, "z-folding-supported", 1);
+    ippAddBoolean(*attrs, IPP_TAG_PRINTER, "z-folding-default", 0);
+  }
+
+  if (model->sideways)
+  {
+    driver_data->vendor[driver_data->num_vendor ++] = "sideways";
+    ippAddBoolean(*attrs, IPP_TAG_PRINTER, "sideways-supported", 1);
+    ippAddBoolean(*attrs, IPP_TAG_PRINTER, "sideways-default", 0);
+  }
+
+  if (model->saddle_stitch)
+  {
+    driver_data->vendor[driver_data->num_vendor ++] = "saddle-stitch";
+    ippAddBoolean(*attrs, IPP_TAG_PRINTER, "saddle-stitch-supported", 1);
+    ippAddBoolean(*attrs, IPP_TAG_PRINTER, "saddle-stitch-default", 0);
+  }
+
+  return (true);
+}
+
+
+//
+// 'brf_index_print_brf()' - Send BRF text to an Index embosser.
+//
+// Software-translated BRF is sent line by line in transparent mode, converted
+// to Index 6-dot codes, like the textbrftoindexv3/v4 CUPS filters do.
+//
+
+bool					// O - `true` on success, `false` on failure
+brf_index_print_brf(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    pappl_device_t     *device,		// I - Output device
+    int                fd)		// I - Input file
+{
+  brf_index_in_t	in;		// Input
+
+
+  in.fd        = fd;
+  in.offset    = 0;
+  in.remaining = -1;
+
+  return (brf_index_send_brf(job, options, device, &in));
+}
+
+
+//
+// 'brf_index_print_part()' - Send a part of a BRF document to an Index
+//                            embosser.
+//
+// Used by embosser pools, which split a document at page boundaries: the
+// part is read with pread() so that parts of the same file can be sent
+// concurrently, and the job pages are counted by the caller.
+//
+
+bool					// O - `true` on success, `false` on failure
+brf_index_print_part(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    pappl_device_t     *device,		// I - Output device
+    int                fd,		// I - Input file
+    off_t              offset,		// I - Offset of the part
+    off_t              length)		// I - Length of the part
+{
+  brf_index_in_t	in;		// Input
+
+
+  in.fd        = fd;
+  in.offset    = offset;
+  in.remaining = length;
+
+  return (brf_index_send_brf(job, options, device, &in));
+}
+
+
+//
+// 'brf_index_send_brf()' - Send BRF text or a part of it.
+//
+
+static bool				// O - `true` on success, `false` on failure
+brf_index_send_brf(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    pappl_device_t     *device,		// I - Output device
+    brf_index_in_t     *in)		// I - Input
+{
+  brf_index_job_t	ij;		// Job parameters
+  brf_index_out_t	*out;		// Output buffer
+  unsigned char		buffer[65536],	// Read buffer
+			*bufptr,	// Pointer into buffer
+			*bufend;	// End of buffer
+  unsigned char		line[128];	// Current line (translated)
+  size_t		linelen = 0;	// Length of current line
+  ssize_t		bytes;		// Bytes read
+  bool			inleading = true,
+					// Still in the leading FFs of the line?
+			prevc2 = false,	// Previous byte was \302 (NBSP lead)?
+			ctrl = false,	// Unsupported control char in line?
+			nonascii = false,
+					// Unsupported non-ASCII char in line?
+			toolong = false,// Line too long?
+			ret = true;	// Return value
+  unsigned char		c;		// Current character
+  brf_scan_t		scan;		// Document statistics
+  bool			progress;	// Count pages while sending?
+  int			fd = in->fd;	// Input file
+
+
+  if (!brf_index_init(job, options, &ij))
+    return (false);
+
+  brf_scan_init(&scan);
+
+  // Pipes from the filter chain cannot be read twice, they are sent while
+  // reading and an overlong line then stops the job where it is found
+  progress = lseek(fd, 0, SEEK_CUR) < 0;
+
+  if (in->remaining >= 0)
+  {
+    // A part of the document: like for a pipe an overlong line stops
+    // it where it is found, and the caller counts the pages
+    progress = false;
+  }
+  else if (!progress)
+  {
+    // Check the whole document before sending anything so that an overlong
+    // line does not leave a partially embossed job, and count its pages...
+    while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
+      brf_scan_data(&scan, buffer, (size_t)bytes);
+    brf_scan_finish(&scan);
+
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "BRF document has %lu pages, %lu lines, longest line %lu characters.", scan.pages, scan.lines, scan.max_line);
+
+    brf_estimate_job(job, options, &scan);
+
+    if (ij.translated && scan.max_line > 127)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Line %lu too long (%lu).", scan.max_line_number, scan.max_line);
+      return (false);
+    }
+
+    if (lseek(fd, 0, SEEK_SET) < 0)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to rewind print file: %s", strerror(errno));
+      return (false);
+    }
+  }
+
+  if ((out = calloc(1, sizeof(brf_index_out_t))) == NULL)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate output buffer: %s", strerror(errno));
+    return (false);
+  }
+
+  out->device = device;
+
+  brf_index_out(out, ij.init, strlen(ij.init));
+
+  if (!ij.translated)
+  {
+    // Not software-translated, send to printer as such
+    papplLogJob(job, PAPPL_LOGLEVEL_INFO, "Writing text to Index embosser");
+
+    while ((bytes = brf_index_read(in, buffer, sizeof(buffer))) > 0 && !out->error)
+    {
+      brf_index_out(out, buffer, (size_t)bytes);
+
+      if (progress)
+        brf_scan_data(&scan, buffer, (size_t)bytes);
+    }
+  }
+  else
+  {
+    // Software-translated, send to printer in transparent mode
+    papplLogJob(job, PAPPL_LOGLEVEL_INFO, "Writing text to Index embosser in transparent mode");
+
+    while (ret && (bytes = brf_index_read(in, buffer, sizeof(buffer))) > 0)
+    {
+      if (progress)
+      {
+        unsigned long pages = scan.pages;// Pages before this buffer
+
+        brf_scan_data(&scan, buffer, (size_t)bytes);
+        if (scan.pages > pages)
+        {
+          papplJobSetImpressions(job, (int)scan.pages + 1);
+          papplJobSetImpressionsCompleted(job, (int)scan.pages);
+        }
+      }
+
+      for (bufptr = buffer, bufend = buffer + bytes; bufptr < bufend; bufptr ++)
+      {
+        c = *bufptr;
+
+        if (prevc2)
+        {
+          // \302\240 is a non-breakable space, a lone \302 is a non-ASCII
+          // character...
+          prevc2 = false;
+
+          if (c == 0240)
+          {
+            c = ' ';
+          }
+          else
+          {
+            nonascii  = true;
+            inleading = false;
+            if (linelen < sizeof(line))
+              line[linelen] = 0x00;
+            else
+              toolong = true;
+            linelen ++;
+          }
+        }
+
+        if (c == '\n')
+        {
+          // End of line, emit it...
+          if (ctrl)
+            papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unsupported control character in BRF file.");
+          if (nonascii)
+            papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unsupported non-ASCII character in BRF file.");
+
+          if (linelen > 127 || toolong)
+          {
+            // Index printers have a bug with numbers between 128 and 255 in
+            // transparent mode escape sequence. This is normally not a problem
+            // since 128 chars is more than a line worth of text
+            papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Line too long (%u).", (unsigned)linelen);
+            ret = false;
+            break;
+          }
+
+          if (linelen > 0)
+          {
+            unsigned char esc[4];	// Transparent mode sequence
+
+            esc[0] = 033;
+            esc[1] = '\\';
+            esc[2] = (unsigned char)linelen;
+            esc[3] = 0x00;
+
+            brf_index_out(out, esc, sizeof(esc));
+            brf_index_out(out, line, linelen);
+          }
+
+          brf_index_out(out, "\r\n", 2);
+
+          linelen   = 0;
+          inleading = true;
+          ctrl      = false;
+          nonascii  = false;
+          toolong   = false;
+          continue;
+        }
+
+        if (c == '\r' || c == 032)
+        {
+          // Strip CRs and ignore SUBs
+          continue;
+        }
+
+        if (c == 0302)
+        {
+          prevc2 = true;
+          continue;
+        }
+
+        if (c == '\f' && inleading)
+        {
+          // Interpret leading FFs
+          brf_index_out(out, "\f", 1);
+          continue;
+        }
+
+        inleading = false;
+
+        if (c == 0240)
+        {
+          // Non-breakable space
+          c = ' ';
+        }
+        else if (c < ' ' || c == 0177)
+        {
+          ctrl = true;
+          c    = ' ';
+        }
+        else if (c >= 0200)
+        {
+          nonascii = true;
+          c        = ' ';
+        }
+
+        // Normalize BRF characters (`a-z{|}~ are non-standard), then turn
+        // them into Index 6-dot codes
+        if (c == '~')
+          c = '_';
+        else if (c >= 0x60)
+          c -= 0x20;
+
+        if (linelen < sizeof(line))
+          line[linelen] = brf_index_6dots[c - ' '];
+        else
+          toolong = true;
+
+        linelen ++;
+      }
+    }
+
+    if (ret && (linelen > 0 || prevc2))
+    {
+      // Last line without a newline...
+      if (prevc2)
+      {
+        nonascii = true;
+        if (linelen < sizeof(line))
+          line[linelen] = 0x00;
+        linelen ++;
+      }
+
+      if (ctrl)
+        papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unsupported control character in BRF file.");
+      if (nonascii)
+        papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unsupported non-ASCII character in BRF file.");
+
+      if (linelen > 127 || toolong)
+      {
+        papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Line too long (%u).", (unsigned)linelen);
+        ret = false;
+      }
+      else
+      {
+        unsigned char esc[4];		// Transparent mode sequence
+
+        esc[0] = 033;
+        esc[1] = '\\';
+        esc[2] = (unsigned char)linelen;
+        esc[3] = 0x00;
+
+        brf_index_out(out, esc, sizeof(esc));
+        brf_index_out(out, line, linelen);
+      }
+    }
+  }
+
+  // Finish document
+  brf_index_out(out, "\032", 1);
+  brf_index_out_flush(out);
+
+  if (progress && ret)
+  {
+    brf_scan_finish(&scan);
+    if (scan.pages > 0)
+      papplJobSetImpressions(job, (int)scan.pages);
+  }
+
+  if (out->error)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to send data to printer.");
+    ret = false;
+  }
+
+  free(out);
+
+  return (ret);
+}
+
+
+//
+// 'brf_index_print_ubrl()' - Send Unicode braille graphics to an Index
+//                            embosser.
+//
+// Each U+28xx pattern is sent as two characters in 4-dot graphic mode, like
+// the imageubrltoindexv3/v4 CUPS filters do (see driver/index/ubrlto4dot.c).
+//
+
+bool					// O - `true` on success, `false` on failure
+brf_index_print_ubrl(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    pappl_device_t     *device,		// I - Output device
+    int                fd)		// I - Input file
+{
+  brf_index_job_t	ij;		// Job parameters
+  brf_index_out_t	*out;		// Output buffer
+  unsigned char		buffer[65536],	// Read buffer
+			*bufptr,	// Pointer into buffer
+			*bufend;	// End of buffer
+  unsigned char		utf8[3];	// Pending UTF-8 sequence
+  int			utf8len = 0;	// Length of pending UTF-8 sequence
+  size_t		pending_at = 0;	// Number of pending trailing '@'
+  bool			inline_ = false,// Anything on the current line?
+			lastcr = false;	// Last character sent was a CR?
+  ssize_t		bytes;		// Bytes read
+  unsigned char		c;		// Current character
+  bool			ret = true;	// Return value
+
+
+  if (!brf_index_init(job, options, &ij))
+    return (false);
+
+  if ((out = calloc(1, sizeof(brf_index_out_t))) == NULL)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate output buffer: %s", strerror(errno));
+    return (false);
+  }
+
+  out->device = device;
+
+  brf_index_out(out, ij.init, strlen(ij.init));
+
+  // Enter 4-dot graphic mode
+  brf_index_out(out, "\033\007", 2);
+
+  papplLogJob(job, PAPPL_LOGLEVEL_INFO, "Writing graphics to Index embosser");
+
+  while ((bytes = read(fd, buffer, sizeof(buffer))) > 0 && !out->error)
+  {
+    for (bufptr = buffer, bufend = buffer + bytes; bufptr < bufend; bufptr ++)
+    {
+      unsigned char	chars[2];	// Characters to send
+      size_t		numchars;	// Number of characters to send
+
+      c = *bufptr;
+
+      if (utf8len > 0)
+      {
+        utf8[utf8len ++] = c;
+
+        if (utf8len == 2 && (c < 0xa0 || c > 0xa3))
+        {
+          // Not a braille pattern, pass through
+          chars[0]  = utf8[0];
+          chars[1]  = utf8[1];
+          numchars  = 2;
+          utf8len   = 0;
+        }
+        else if (utf8len == 3)
+        {
+          // U+2800-U+28FF, convert to a pair of 4-dot characters...
+          unsigned j = ((utf8[1] & 3U) << 6) | (utf8[2] & 0x3fU);
+					// Unicode dot pattern
+          unsigned i = (j & 7) | ((j & 0x40) >> 3) | ((j & 0x38) << 1) | (j & 0x80);
+					// Index dot pattern
+
+          chars[0] = (unsigned char)('@' + (i & 15));
+          chars[1] = (unsigned char)('@' + (i >> 4));
+          numchars = 2;
+          utf8len  = 0;
+        }
+        else
+          continue;
+      }
+      else if (c == 0xe2)
+      {
+        utf8[0] = c;
+        utf8len = 1;
+        continue;
+      }
+      else if (c == '\n')
+      {
+        // Drop trailing blank columns and make sure lines end with a CR
+        pending_at = 0;
+
+        if (!lastcr || !inline_)
+          brf_index_out(out, "\r", 1);
+
+        brf_index_out(out, "\n", 1);
+        inline_ = false;
+        lastcr  = false;
+        continue;
+      }
+      else
+      {
+        chars[0] = c;
+        numchars = 1;
+      }
+
+      for (size_t k = 0; k < numchars; k ++)
+      {
+        if (chars[k] == '@')
+        {
+          pending_at ++;
+          continue;
+        }
+
+        while (pending_at > 0)
+        {
+          brf_index_out(out, "@", 1);
+          pending_at --;
+        }
+
+        brf_index_out(out, chars + k, 1);
+        inline_ = true;
+        lastcr  = chars[k] == '\r';
+      }
+    }
+  }
+
+  if (utf8len > 0)
+    brf_index_out(out, utf8, (size_t)utf8len);
+
+  if (inline_ && !lastcr)
+    brf_index_out(out, "\r", 1);
+
+  // Exit 4-dot graphic mode and finish document
+  brf_index_out(out, "\033\006\032", 3);
+  brf_index_out_flush(out);
+
+  if (out->error)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to send data to printer.");
+    ret = false;
+  }
+
+  free(out);
+
+  return (ret);
+}
+
+
+//
+// 'brf_index_init()' - Compute the job parameters and INIT sequence.
+//
+
+static bool				// O - `true` on success, `false` on error
+brf_index_init(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    brf_index_job_t    *ij)		// O - Job parameters
+{
+  pappl_pr_driver_data_t driver_data;	// Driver data
+  const brf_index_model_t *model;	// Model
+  int		firmware,		// Firmware version
+		text_dot_distance,	// Text dot distance (1/100 mm)
+		text_cell_distance,	// Text cell distance (1/100 mm)
+		text_dots,		// Text dots (6 or 8)
+		line_spacing,		// Line spacing (1/100 mm)
+		graphic_dot_distance,	// Graphic dot distance (1/100 mm)
+		multiple_impact,	// Multiple impact
+		table,			// Firmware braille table
+		copies;			// Number of copies
+  bool		duplex,			// Double-sided?
+		z_folding,		// Z-folding?
+		sideways,		// Sideways?
+		saddle_stitch;		// Saddle stitch?
+  int		dp;			// DP value
+  char		*ptr,			// Pointer into INIT
+		*end;			// End of INIT
+  char		pw[16],			// Paper width
+		pl[16];			// Paper length
+
+
+  memset(ij, 0, sizeof(brf_index_job_t));
+
+  papplPrinterGetDriverData(papplJobGetPrinter(job), &driver_data);
+  if ((model = (const brf_index_model_t *)driver_data.extension) == NULL)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Printer does not use an Index driver.");
+    return (false);
+  }
+
+  ij->model      = model;
+  ij->translated = !strcmp(brf_index_vendor(options, "software-translated", "true"), "true");
+
+  firmware             = atoi(brf_index_vendor(options, "index-firmware-version", "103000"));
+  text_dot_distance    = atoi(brf_index_vendor(options, "text-dot-distance", "250"));
+  text_dots            = atoi(brf_index_vendor(options, "text-dots", "6"));
+  line_spacing         = atoi(brf_index_vendor(options, "line-spacing", "500"));
+  graphic_dot_distance = atoi(brf_index_vendor(options, "graphic-dot-distance", "200"));
+  multiple_impact      = atoi(brf_index_vendor(options, "multiple-impact", "1"));
+  table                = atoi(brf_index_vendor(options, "index-table", model->gen == BRF_INDEX_V3 ? "0" : "5"));
+  z_folding            = model->z_folding && !strcmp(brf_index_vendor(options, "z-folding", "false"), "true");
+  sideways             = model->sideways && !strcmp(brf_index_vendor(options, "sideways", "false"), "true");
+  saddle_stitch        = model->saddle_stitch && !strcmp(brf_index_vendor(options, "saddle-stitch", "false"), "true");
+  copies               = options->copies > 0 ? options->copies : 1;
+
+  if (options->sides == PAPPL_SIDES_ONE_SIDED || options->sides == 0)
+    duplex = false;
+  else if (options->sides == PAPPL_SIDES_TWO_SIDED_LONG_EDGE && model->duplex)
+    duplex = true;
+  else
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Duplex mode is not supported.");
+    return (false);
+  }
+
+  if (firmware < 103000)
+  {
+    // No support for temporary parameters.  Hoping that the user configured
+    // the embosser the same way.
+    return (true);
+  }
+
+  // Firmware 10.30 and above support temporary parameters, margins are
+  // implemented in software
+  ptr = ij->init;
+  end = ij->init + sizeof(ij->init);
+
+  ptr += snprintf(ptr, (size_t)(end - ptr), "\033DTM0,BI0");
+
+  // Common options: disable first line offset and page numbering, support
+  // hardware-assisted multiple copies
+  ptr += snprintf(ptr, (size_t)(end - ptr), ",FO0");
+  if (copies != 1)
+    ptr += snprintf(ptr, (size_t)(end - ptr), ",MC%d", copies);
+  ptr += snprintf(ptr, (size_t)(end - ptr), ",MI%d", multiple_impact);
+
+  if (!z_folding && !saddle_stitch && !sideways)
+    dp = duplex ? 2 : 1;		// Single/Double Sided
+  else if (z_folding && !saddle_stitch && !sideways)
+    dp = duplex ? 3 : 5;		// z-folding
+  else if (!z_folding && saddle_stitch && !sideways)
+    dp = duplex ? 4 : 8;		// Saddle Stitch
+  else if (z_folding && !saddle_stitch && sideways)
+    dp = duplex ? 6 : 7;		// z-folding sideways
+  else
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unsupported page folding: duplex=%d z-folding=%d sideways=%d saddle-stitch=%d", duplex, z_folding, sideways, saddle_stitch);
+    return (false);
+  }
+  ptr += snprintf(ptr, (size_t)(end - ptr), ",DP%d", dp);
+
+  // Configure dots spacing
+  switch (text_dot_distance)
+  {
+    case 220 :
+        text_cell_distance = 310;
+        ptr += snprintf(ptr, (size_t)(end - ptr), ",TD1");
+        break;
+    case 250 :
+        text_cell_distance = 350;
+        ptr += snprintf(ptr, (size_t)(end - ptr), ",TD0");
+        break;
+    case 320 :
+        text_cell_distance = 525;
+        ptr += snprintf(ptr, (size_t)(end - ptr), ",TD2");
+        break;
+    default :
+        papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unsupported '%d' text dot distance.", text_dot_distance);
+        return (false);
+  }
+
+  switch (graphic_dot_distance)
+  {
+    case 160 :
+        ptr += snprintf(ptr, (size_t)(end - ptr), ",GD2");
+        break;
+    case 200 :
+        ptr += snprintf(ptr, (size_t)(end - ptr), ",GD0");
+        break;
+    case 250 :
+        ptr += snprintf(ptr, (size_t)(end - ptr), ",GD1");
+        break;
+    default :
+        papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unsupported '%d' graphic dot distance.", graphic_dot_distance);
+        return (false);
+  }
+
+  // Page numbers are implemented in software
+  ptr += snprintf(ptr, (size_t)(end - ptr), ",PN0");
+
+  if (model->gen == BRF_INDEX_V3)
+  {
+    // Paper size
+    switch (model->paper_length)
+    {
+      case BRF_INDEX_LENGTH_IN :
+          brf_index_mm_to_in(options->media.size_width, pw, sizeof(pw));
+          brf_index_mm_to_in(options->media.size_length, pl, sizeof(pl));
+          ptr += snprintf(ptr, (size_t)(end - ptr), ",PW%s,PL%s", pw, pl);
+          break;
+      case BRF_INDEX_LENGTH_MM :
+          ptr += snprintf(ptr, (size_t)(end - ptr), ",PW%d,PL%d", options->media.size_width / 100, options->media.size_length / 100);
+          break;
+      default :
+          break;
+    }
+
+    switch (line_spacing)
+    {
+      case 250 :  ptr += snprintf(ptr, (size_t)(end - ptr), ",LS0"); break;
+      case 375 :  ptr += snprintf(ptr, (size_t)(end - ptr), ",LS1"); break;
+      case 450 :  ptr += snprintf(ptr, (size_t)(end - ptr), ",LS2"); break;
+      case 475 :  ptr += snprintf(ptr, (size_t)(end - ptr), ",LS3"); break;
+      case 500 :  ptr += snprintf(ptr, (size_t)(end - ptr), ",LS4"); break;
+      case 525 :  ptr += snprintf(ptr, (size_t)(end - ptr), ",LS5"); break;
+      case 550 :  ptr += snprintf(ptr, (size_t)(end - ptr), ",LS6"); break;
+      case 750 :  ptr += snprintf(ptr, (size_t)(end - ptr), ",LS7"); break;
+      case 1000 : ptr += snprintf(ptr, (size_t)(end - ptr), ",LS8"); break;
+      default :
+          if (firmware < 120130)
+          {
+            papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unsupported %d line spacing, please upgrade firmware to at least 12.01.3.", line_spacing);
+            return (false);
+          }
+          if (line_spacing < 100)
+          {
+            papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Too small %d line spacing.", line_spacing);
+            return (false);
+          }
+          ptr += snprintf(ptr, (size_t)(end - ptr), ",LS%d", line_spacing / 10);
+          break;
+    }
+
+    if (ij->translated)
+    {
+      // Software-translated, enforce a 6-dot table if needed, hoping the user
+      // properly configured an 8-dot table otherwise
+      if (text_dots == 6)
+        ptr += snprintf(ptr, (size_t)(end - ptr), ",BT0");
+      else if (text_dots != 8)
+      {
+        papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unsupported %d dots.", text_dots);
+        return (false);
+      }
+    }
+    else
+      ptr += snprintf(ptr, (size_t)(end - ptr), ",BT%d", table);
+  }
+  else
+  {
+    // Paper size in characters and lines, from the printable area
+    int printable_width  = options->media.size_width - model->margins[0] - model->margins[2],
+	printable_height = options->media.size_length - model->margins[1] - model->margins[3],
+	cell_width       = text_dot_distance + text_cell_distance,
+	cell_height      = text_dot_distance * (text_dots / 2 - 1) + line_spacing;
+
+    ptr += snprintf(ptr, (size_t)(end - ptr), ",CH%d,LP%d", (printable_width + text_cell_distance) / cell_width, (printable_height + line_spacing) / cell_height);
+
+    switch (line_spacing)
+    {
+      case 500 :  ptr += snprintf(ptr, (size_t)(end - ptr), ",LS50"); break;
+      case 1000 : ptr += snprintf(ptr, (size_t)(end - ptr), ",LS100"); break;
+      default :
+          papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unsupported %d line spacing.", line_spacing);
+          return (false);
+    }
+
+    if (ij->translated)
+    {
+      // Software-translated, enforce a 6-dot or 8-dot table
+      if (text_dots == 6)
+        ptr += snprintf(ptr, (size_t)(end - ptr), ",BT0");
+      else if (text_dots == 8)
+        ptr += snprintf(ptr, (size_t)(end - ptr), ",BT6");
+      else
+      {
+        papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unsupported %d dots.", text_dots);
+        return (false);
+      }
+    }
+    else
+      ptr += snprintf(ptr, (size_t)(end - ptr), ",BT%d", table);
+  }
+
+  snprintf(ptr, (size_t)(end - ptr), ";");
+
+  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Index INIT sequence is 'ESC%s'.", ij->init + 1);
+
+  return (true);
+}
+
+
+//
+// 'brf_index_mm_to_in()' - Convert 1/100 mm to the Index inch notation.
+//
+
+static void
+brf_index_mm_to_in(int    mm,		// I - Length in 1/100 mm
+                   char   *buffer,	// I - Output buffer
+                   size_t bufsize)	// I - Size of output buffer
+{
+  int	in120 = mm * 12 / 254,		// Length in 1/120 inches
+	frac = in120 % 120;		// Fractional part in 1/120 inches
+
+
+  // Convert to Index-specific values, rounding down to zero, a quarter, a
+  // third, a half, two thirds or three quarters
+  if (frac < 30)
+    frac = 0;
+  else if (frac < 40)
+    frac = 1;
+  else if (frac < 60)
+    frac = 2;
+  else if (frac < 80)
+    frac = 3;
+  else if (frac < 90)
+    frac = 4;
+  else
+    frac = 5;
+
+  snprintf(buffer, bufsize, "%d%d", in120 / 120, frac);
+}
+
+
+//
+// 'brf_index_out()' - Buffer output to the device.
+//
+
+static void
+brf_index_out(brf_index_out_t *out,	// I - Output buffer
+              const void      *data,	// I - Data
+              size_t          len)	// I - Length of data
+{
+  if (out->used + len > sizeof(out->buffer))
+    brf_index_out_flush(out);
+
+  if (len > sizeof(out->buffer))
+  {
+    if (!out->error && papplDeviceWrite(out->device, data, len) < 0)
+      out->error = true;
+    return;
+  }
+
+  memcpy(out->buffer + out->used, data, len);
+  out->used += len;
+}
+
+
+//
+// 'brf_index_out_flush()' - Flush buffered output to the device.
+//
+
+static void
+brf_index_out_flush(brf_index_out_t *out)// I - Output buffer
+{
+  if (out->used > 0 && !out->error && papplDeviceWrite(out->device, out->buffer, out->used) < 0)
+    out->error = true;
+
+  out->used = 0;
+}
+
+
+//
+// 'brf_index_read()' - Read the next buffer of a document or part.
+//
+
+static ssize_t				// O - Bytes read, 0 at the end or -1 on error
+brf_index_read(brf_index_in_t *in,	// I - Input
+               void           *buffer,	// I - Buffer
+               size_t         bufsize)	// I - Size of buffer
+{
+  ssize_t	bytes;			// Bytes read
+
+
+  if (in->remaining < 0)
+    return (read(in->fd, buffer, bufsize));
+
+  if ((off_t)bufsize > in->remaining)
+    bufsize = (size_t)in->remaining;
+
+  if (bufsize == 0)
+    return (0);
+
+  if ((bytes = pread(in->fd, buffer, bufsize, in->offset)) > 0)
+  {
+    in->offset    += bytes;
+    in->remaining -= bytes;
+  }
+
+  return (bytes);
+}
+
+
+//
+// 'brf_index_printfile()' - Print a file.
+//
+
+static bool				// O - `true` on success, `false` on failure
+brf_index_printfile(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    pappl_device_t     *device)		// I - Output device
+{
+  int	fd;				// Input file
+  bool	ret;				// Return value
+
+
+  papplJobSetImpressions(job, 1);
+
+  if ((fd = open(papplJobGetFilename(job), O_RDONLY)) < 0)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to open print file '%s': %s", papplJobGetFilename(job), strerror(errno));
+    return (false);
+  }
+
+  if (brf_pool_printer(papplJobGetPrinter(job)))
+    ret = brf_pool_print(job, options, fd, true);
+  else
+    ret = brf_index_print_brf(job, options, device, fd);
+
+  close(fd);
+
+  if (ret)
+    papplJobSetImpressionsCompleted(job, papplJobGetImpressions(job));
+
+  return (ret);
+}
+
+
+//
+// 'brf_index_rendjob()' - End a job.
+//
+
+static bool				// O - `true` on success, `false` on failure
+brf_index_rendjob(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    pappl_device_t     *device)		// I - Output device
+{
+  (void)job;
+  (void)options;
+  (void)device;
+
+  return (true);
+}
+
+
+//
+// 'brf_index_rendpage()' - End a page.
+//
+
+static bool				// O - `true` on success, `false` on failure
+brf_index_rendpage(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    pappl_device_t     *device,		// I - Output device
+    unsigned           page)		// I - Page number
+{
+  (void)job;
+  (void)options;
+  (void)device;
+  (void)page;
+
+  return (true);
+}
+
+
+//
+// 'brf_index_rstartjob()' - Start a job.
+//
+
+static bool				// O - `true` on success, `false` on failure
+brf_index_rstartjob(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    pappl_device_t     *device)		// I - Output device
+{
+  (void)options;
+  (void)device;
+
+  // Raster input is not supported, only BRF and UBRL
+  papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Raster printing is not supported by Index embossers.");
+
+  return (false);
+}
+
+
+//
+// 'brf_index_rstartpage()' - Start a page.
+//
+
+static bool				// O - `true` on success, `false` on failure
+brf_index_rstartpage(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    pappl_device_t     *device,		// I - Output device
+    unsigned           page)		// I - Page number
+{
+  (void)job;
+  (void)options;
+  (void)device;
+  (void)page;
+
+  return (false);
+}
+
+
+//
+// 'brf_index_rwriteline()' - Write a raster line.
+//
+
+static bool				// O - `true` on success, `false` on failure
+brf_index_rwriteline(
+    pappl_job_t         *job,		// I - Job
+    pappl_pr_options_t  *options,	// I - Job options
+    pappl_device_t      *device,	// I - Output device
+    unsigned            y,		// I - Line number
+    const unsigned char *line)		// I - Line
+{
+  (void)job;
+  (void)options;
+  (void)device;
+  (void)y;
+  (void)line;
+
+  return (false);
+}
+
+
+//
+// 'brf_index_status()' - Get current printer status.
+//
+
+static bool				// O - `true` on success, `false` on failure
+brf_index_status(
+    pappl_printer_t *printer)		// I - Printer
+{
+  (void)printer;
+
+  return (true);
+}
+
+
+//
+// 'brf_index_vendor()' - Get a vendor option value.
+//
+
+static const char *			// O - Value
+brf_index_vendor(
+    pappl_pr_options_t *options,	// I - Job options
+    const char         *name,		// I - Option name
+    const char         *defval)		// I - Default value
+{
+  const char	*val;			// Value
+
+
+  if ((val = cupsGetOption(name, options->num_vendor, options->vendor)) == NULL || !*val)
+    val = defval;
+
+  return (val);
+}
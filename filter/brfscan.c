@@ -0,0 +1,180 @@
+//
+// BRF validation and statistics scanner
+//
+// Copyright (c) 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Counts pages, lines, the longest line and unsupported characters of a BRF
+// document in one pass.  Runs of printable ASCII are consumed 8 bytes at a
+// time; only CR/LF/FF and invalid bytes go through the per-byte state
+// machine.
+//
+
+#include "brfscan.h"
+#include <stdint.h>
+#include <string.h>
+
+#define BRF_SCAN_ONES	UINT64_C(0x0101010101010101)
+#define BRF_SCAN_HIGH	UINT64_C(0x8080808080808080)
+
+
+//
+// 'brf_scan_end_line()' - Account for the end of the current line.
+//
+
+static void
+brf_scan_end_line(brf_scan_t *scan)	// I - Scanner
+{
+  scan->lines ++;
+  scan->cells += scan->line_len;
+
+  if (scan->line_len > scan->max_line)
+  {
+    scan->max_line        = scan->line_len;
+    scan->max_line_number = scan->lines;
+  }
+
+  scan->line_len   = 0;
+  scan->in_leading = 1;
+  scan->in_line    = 0;
+}
+
+
+//
+// 'brf_scan_init()' - Initialize a scanner.
+//
+
+void
+brf_scan_init(brf_scan_t *scan)		// I - Scanner
+{
+  memset(scan, 0, sizeof(brf_scan_t));
+
+  scan->in_leading = 1;
+}
+
+
+//
+// 'brf_scan_data()' - Scan a buffer of BRF data.
+//
+
+void
+brf_scan_data(brf_scan_t *scan,		// I - Scanner
+              const void *data,		// I - Data
+              size_t     len)		// I - Length of data
+{
+  const unsigned char	*ptr = (const unsigned char *)data,
+					// Pointer into data
+			*end = ptr + len;
+					// End of data
+  uint64_t		w;		// Current word
+  unsigned char		c;		// Current byte
+
+
+  while (ptr < end)
+  {
+    if (!scan->prev_c2 && end - ptr >= 8)
+    {
+      memcpy(&w, ptr, sizeof(w));
+
+      // Printable ASCII only: no high bit, nothing below 0x20, no 0x7f.  The
+      // additions cannot carry between bytes once the high bits are clear.
+      if (!(w & BRF_SCAN_HIGH) &&
+          !((~(w + 0x60 * BRF_SCAN_ONES) | (w + BRF_SCAN_ONES)) & BRF_SCAN_HIGH))
+      {
+        scan->line_len   += 8;
+        scan->in_leading = 0;
+        scan->in_line    = 1;
+        scan->in_page    = 1;
+        ptr              += 8;
+        continue;
+      }
+    }
+
+    c = *ptr++;
+
+    if (scan->prev_c2)
+    {
+      // \302\240 is a non-breakable space, a lone \302 is a non-ASCII
+      // character...
+      scan->prev_c2 = 0;
+
+      scan->line_len   ++;
+      scan->in_leading = 0;
+      scan->in_page    = 1;
+
+      if (c == 0240)
+        continue;
+
+      scan->nonascii ++;
+    }
+
+    if (c == '\n')
+    {
+      brf_scan_end_line(scan);
+      continue;
+    }
+
+    scan->in_line = 1;
+
+    if (c == '\r' || c == 032)
+      continue;
+
+    if (c == '\f')
+    {
+      // Each FF ends a page, even an empty one
+      scan->pages ++;
+      scan->in_page = 0;
+
+      if (scan->in_leading)
+        continue;
+
+      // FFs in the middle of a line are sent as such
+      scan->control ++;
+      scan->line_len ++;
+      continue;
+    }
+
+    scan->in_leading = 0;
+    scan->in_page    = 1;
+
+    if (c == 0302)
+    {
+      scan->prev_c2 = 1;
+      continue;
+    }
+
+    if (c == 0240)
+      ;
+    else if (c < ' ' || c == 0177)
+      scan->control ++;
+    else if (c >= 0200)
+      scan->nonascii ++;
+
+    scan->line_len ++;
+  }
+}
+
+
+//
+// 'brf_scan_finish()' - Account for the end of the document.
+//
+
+void
+brf_scan_finish(brf_scan_t *scan)	// I - Scanner
+{
+  if (scan->prev_c2)
+  {
+    scan->prev_c2 = 0;
+    scan->nonascii ++;
+    scan->line_len ++;
+    scan->in_page = 1;
+  }
+
+  if (scan->in_line)
+    brf_scan_end_line(scan);
+
+  if (scan->in_page)
+    scan->pages ++;
+}
@@ -0,0 +1,43 @@
+//
+// BRF validation and statistics scanner
+//
+// Copyright (c) 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+#ifndef BRFSCAN_H
+#  define BRFSCAN_H
+
+#  include <stddef.h>
+
+//
+// Line lengths are counted the way the Index drivers send them in transparent
+// mode: CRs and SUBs are dropped, leading FFs are not part of the line and a
+// UTF-8 non-breakable space counts as one character.
+//
+
+typedef struct brf_scan_s		// BRF scanner state and results
+{
+  unsigned long	pages,			// Number of pages
+		lines,			// Number of lines
+		cells,			// Number of cells in all lines
+		max_line,		// Longest line, in characters
+		max_line_number,	// Line number of the longest line
+		control,		// Unsupported control characters
+		nonascii;		// Unsupported non-ASCII characters
+
+  // Private state...
+  unsigned long	line_len;		// Length of current line
+  int		in_leading,		// In the leading FFs of the line?
+		in_line,		// Current line has any data?
+		in_page,		// Current page has any content?
+		prev_c2;		// Previous byte was \302?
+} brf_scan_t;
+
+extern void	brf_scan_init(brf_scan_t *scan);
+extern void	brf_scan_data(brf_scan_t *scan, const void *data, size_t len);
+extern void	brf_scan_finish(brf_scan_t *scan);
+
+#endif // !BRFSCAN_H
@@ -0,0 +1,120 @@
+//
+// BRF statistics tool for the braille filters
+//
+// Copyright (c) 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage: brfstat [-c] [-n pages] [filename]
+//
+// Prints the page, line and cell counts, the longest line and the number of
+// unsupported characters of a BRF document as shell variable assignments.
+// With -c the document is copied to stdout and the summary goes to stderr
+// as a DEBUG message, so that it can sit in a filter pipeline.  With -n the
+// input is only read up to the form feed ending the given page, like
+// brftopagedbrf counts pages, so that the commands before it in a pipeline
+// get SIGPIPE instead of producing pages nobody asked for.  Without a
+// filename, or with an empty one like the FILE of a filter reading its
+// standard input, the document is read from stdin.
+//
+
+#include "brfscan.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+int
+main(int argc,
+     char *argv[])
+{
+  brf_scan_t scan;
+  unsigned char buffer[65536];
+  ssize_t bytes, written, done;
+  const char *filename = NULL;
+  int copy = 0;
+  int fd = 0;
+  int i;
+  long limit = 0, pages = 0;
+  unsigned char *ff;
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "-c"))
+      copy = 1;
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc && (limit = atol(argv[i + 1])) > 0)
+      i ++;
+    else if (!filename && argv[i][0] != '-')
+      filename = argv[i];
+    else
+    {
+      fprintf(stderr, "Usage: brfstat [-c] [-n pages] [filename]\n");
+      return (1);
+    }
+  }
+
+  if (filename && *filename && (fd = open(filename, O_RDONLY)) < 0)
+  {
+    fprintf(stderr, "ERROR: brfstat: Unable to open %s: %s\n", filename, strerror(errno));
+    return (1);
+  }
+
+  brf_scan_init(&scan);
+
+  while ((bytes = read(fd, buffer, sizeof(buffer))) != 0)
+  {
+    if (bytes < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      fprintf(stderr, "ERROR: brfstat: Unable to read input: %s\n", strerror(errno));
+      return (1);
+    }
+
+    if (limit)
+    {
+      // Cut the buffer after the form feed ending the last page
+      for (ff = buffer; (ff = memchr(ff, '\f', (size_t)(buffer + bytes - ff))) != NULL; ff ++)
+      {
+        if (++ pages == limit)
+        {
+          bytes = ff + 1 - buffer;
+          break;
+        }
+      }
+    }
+
+    brf_scan_data(&scan, buffer, (size_t)bytes);
+
+    for (done = 0; copy && done < bytes; done += written)
+    {
+      if ((written = write(1, buffer + done, (size_t)(bytes - done))) < 0)
+      {
+        if (errno == EINTR || errno == EAGAIN)
+        {
+          written = 0;
+          continue;
+        }
+        fprintf(stderr, "ERROR: brfstat: Unable to write output: %s\n", strerror(errno));
+        return (1);
+      }
+    }
+
+    if (limit && pages >= limit)
+      break;
+  }
+
+  brf_scan_finish(&scan);
+
+  fprintf(copy ? stderr : stdout,
+	  "%sPAGES=%lu LINES=%lu CELLS=%lu MAXLINE=%lu MAXLINENUMBER=%lu CONTROL=%lu NONASCII=%lu\n",
+	  copy ? "DEBUG: brfstat: " : "",
+	  scan.pages, scan.lines, scan.cells, scan.max_line, scan.max_line_number,
+	  scan.control, scan.nonascii);
+
+  return (0);
+}
@@ -0,0 +1,673 @@
+//
+// MusicXML translation worker for the braille filters
+//
+// Copyright (c) 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage: freedots-worker -s socket
+//        freedots-worker -p socket
+//        freedots-worker -c socket width tables
+//
+// FreeDots is a Java program, starting it takes much longer than translating
+// a typical score.  With -s this program listens on a Unix socket and keeps
+// a FreeDots process started ahead of time for each recently used line
+// width, waiting for its input on a pipe, so that a job only pays for the
+// translation itself.  The braille output of FreeDots is translated with
+// liblouis in the worker, so the tables are only compiled once.  Jobs are
+// handled concurrently, one thread each.
+//
+// With -c the input (stdin), output (stdout) and error (stderr) file
+// descriptors are passed to the worker, which does the same as
+//
+//   FreeDots -nw -w width /dev/stdin | lou_translate tables
+//
+// and the exit status is the one of the job.  The exit status is 2 when the
+// worker is not running or dropped the job before reading its input or
+// writing any output, so that the caller can still run FreeDots itself.  -p
+// checks whether a worker is listening.
+//
+// The socket is only accessible to the user and group of the worker (0660)
+// and connections from other users than root, the worker's user and members
+// of its primary group are refused.  The systemd unit runs it as lp:lp in
+// /run/cups-braille, created with mode 0750 by tmpfiles.d.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <liblouis.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+#define MAX_SPARES	4		// Max number of waiting FreeDots
+
+
+//
+// Types...
+//
+
+typedef struct
+{
+  int	width;				// Line width (0 = free slot)
+  pid_t	pid;				// Process ID
+  int	infd,				// Pipe to FreeDots input
+	outfd;				// Pipe from FreeDots output
+} spare_t;
+
+typedef struct
+{
+  int	from,				// Copy from
+	to;				// Copy to
+} copy_t;
+
+
+//
+// Globals...
+//
+
+static pthread_mutex_t	spares_mutex = PTHREAD_MUTEX_INITIALIZER;
+static spare_t		spares[MAX_SPARES];
+static pthread_mutex_t	louis_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// liblouis is not thread-safe
+
+
+//
+// 'copy_input()' - Copy the job input to FreeDots.
+//
+
+static void *
+copy_input(void *data)
+{
+  copy_t	*copy = (copy_t *)data;
+  char		buffer[65536];
+  ssize_t	bytes, written, done;
+
+  while ((bytes = read(copy->from, buffer, sizeof(buffer))) != 0)
+  {
+    if (bytes < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+	continue;
+      break;
+    }
+
+    for (done = 0; done < bytes; done += written)
+    {
+      if ((written = write(copy->to, buffer + done, (size_t)(bytes - done))) < 0)
+      {
+	if (errno == EINTR || errno == EAGAIN)
+	{
+	  written = 0;
+	  continue;
+	}
+	goto finish;
+      }
+    }
+  }
+
+  finish:
+
+  close(copy->to);
+
+  return (NULL);
+}
+
+
+//
+// 'start_freedots()' - Start a FreeDots process waiting for its input.
+//
+
+static int
+start_freedots(int width,
+	       spare_t *spare)
+{
+  int	inpipe[2], outpipe[2];
+  char	widthstr[16];
+
+  if (pipe2(inpipe, O_CLOEXEC))
+    return (-1);
+
+  if (pipe2(outpipe, O_CLOEXEC))
+  {
+    close(inpipe[0]);
+    close(inpipe[1]);
+    return (-1);
+  }
+
+  snprintf(widthstr, sizeof(widthstr), "%d", width);
+
+  if ((spare->pid = fork()) == 0)
+  {
+    dup2(inpipe[0], 0);
+    dup2(outpipe[1], 1);
+    execlp("FreeDots", "FreeDots", "-nw", "-w", widthstr, "/dev/stdin", (char *)NULL);
+    _exit(127);
+  }
+
+  close(inpipe[0]);
+  close(outpipe[1]);
+
+  if (spare->pid < 0)
+  {
+    close(inpipe[1]);
+    close(outpipe[0]);
+    return (-1);
+  }
+
+  spare->width = width;
+  spare->infd  = inpipe[1];
+  spare->outfd = outpipe[0];
+
+  return (0);
+}
+
+
+//
+// 'get_freedots()' - Take a waiting FreeDots process and start its successor.
+//
+
+static int
+get_freedots(int width,
+	     spare_t *job)
+{
+  spare_t	next,
+		victim = { 0, 0, -1, -1 };
+  int		i, slot = -1;
+
+  pthread_mutex_lock(&spares_mutex);
+
+  for (i = 0; i < MAX_SPARES; i ++)
+  {
+    if (spares[i].width == width)
+    {
+      *job = spares[i];
+      spares[i].width = 0;
+      slot = i;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&spares_mutex);
+
+  if (slot < 0 && start_freedots(width, job))
+    return (-1);
+
+  // Start the one for the next job with this width, replacing the oldest
+  // waiting process if all slots are used
+  if (start_freedots(width, &next))
+    return (0);
+
+  pthread_mutex_lock(&spares_mutex);
+
+  for (i = 0; i < MAX_SPARES; i ++)
+  {
+    if (spares[i].width == 0)
+      break;
+  }
+
+  if (i >= MAX_SPARES)
+    victim = spares[i = MAX_SPARES - 1];
+
+  memmove(spares + 1, spares, (size_t)i * sizeof(spare_t));
+  spares[0] = next;
+
+  pthread_mutex_unlock(&spares_mutex);
+
+  if (victim.width)
+  {
+    kill(victim.pid, SIGTERM);
+    close(victim.infd);
+    close(victim.outfd);
+    waitpid(victim.pid, NULL, 0);
+  }
+
+  return (0);
+}
+
+
+//
+// 'translate()' - Translate FreeDots output with liblouis.
+//
+
+static int
+translate(FILE *in,
+	  FILE *out,
+	  const char *tables)
+{
+  char		*line = NULL, *ptr;
+  size_t	linesize = 0;
+  ssize_t	linelen;
+  widechar	*inbuf = NULL, *outbuf = NULL;
+  int		insize = 0, inlen, outlen, i, ok = 1;
+  unsigned long	ch;
+
+  while ((linelen = getline(&line, &linesize, in)) >= 0)
+  {
+    if (linelen > 0 && line[linelen - 1] == '\n')
+      line[-- linelen] = '\0';
+
+    if (linelen + 1 > insize)
+    {
+      insize = (int)linelen + 1;
+      free(inbuf);
+      free(outbuf);
+      inbuf  = malloc((size_t)insize * sizeof(widechar));
+      outbuf = malloc((size_t)insize * 4 * sizeof(widechar));
+      if (!inbuf || !outbuf)
+      {
+	ok = 0;
+	break;
+      }
+    }
+
+    // UTF-8 to widechar
+    for (ptr = line, inlen = 0; *ptr; inlen ++)
+    {
+      ch = (unsigned char)*ptr++;
+      if (ch >= 0xf0 && ptr[0] && ptr[1] && ptr[2])
+      {
+	ch = ((ch & 0x07) << 18) | ((ptr[0] & 0x3f) << 12) | ((ptr[1] & 0x3f) << 6) | (ptr[2] & 0x3f);
+	ptr += 3;
+      }
+      else if (ch >= 0xe0 && ptr[0] && ptr[1])
+      {
+	ch = ((ch & 0x0f) << 12) | ((ptr[0] & 0x3f) << 6) | (ptr[1] & 0x3f);
+	ptr += 2;
+      }
+      else if (ch >= 0xc0 && ptr[0])
+      {
+	ch = ((ch & 0x1f) << 6) | (ptr[0] & 0x3f);
+	ptr ++;
+      }
+
+      inbuf[inlen] = (sizeof(widechar) == 2 && ch > 0xffff) ? '?' : (widechar)ch;
+    }
+
+    outlen = insize * 4;
+
+    pthread_mutex_lock(&louis_mutex);
+    if (!lou_translateString(tables, inbuf, &inlen, outbuf, &outlen, NULL, NULL, 0))
+      outlen = -1;
+    pthread_mutex_unlock(&louis_mutex);
+
+    if (outlen < 0)
+    {
+      ok = 0;
+      break;
+    }
+
+    // widechar to UTF-8
+    for (i = 0; i < outlen; i ++)
+    {
+      ch = outbuf[i];
+
+      if (ch < 0x80)
+      {
+	putc((int)ch, out);
+      }
+      else if (ch < 0x800)
+      {
+	putc((int)(0xc0 | (ch >> 6)), out);
+	putc((int)(0x80 | (ch & 0x3f)), out);
+      }
+      else if (ch < 0x10000)
+      {
+	putc((int)(0xe0 | (ch >> 12)), out);
+	putc((int)(0x80 | ((ch >> 6) & 0x3f)), out);
+	putc((int)(0x80 | (ch & 0x3f)), out);
+      }
+      else
+      {
+	putc((int)(0xf0 | (ch >> 18)), out);
+	putc((int)(0x80 | ((ch >> 12) & 0x3f)), out);
+	putc((int)(0x80 | ((ch >> 6) & 0x3f)), out);
+	putc((int)(0x80 | (ch & 0x3f)), out);
+      }
+    }
+
+    putc('\n', out);
+  }
+
+  free(line);
+  free(inbuf);
+  free(outbuf);
+
+  if (fflush(out))
+    ok = 0;
+
+  return (ok);
+}
+
+
+//
+// 'run_job()' - Handle a client connection.
+//
+
+static void *
+run_job(void *data)
+{
+  int			sock = (int)(long)data;
+  char			request[1024], *tables, status;
+  int			fds[3] = { -1, -1, -1 }, width, i;
+  struct msghdr		msg;
+  struct iovec		iov;
+  union
+  {
+    struct cmsghdr	hdr;
+    char		buf[CMSG_SPACE(sizeof(fds))];
+  }			control;
+  struct cmsghdr	*cmsg;
+  ssize_t		bytes;
+  spare_t		job;
+  copy_t		copy;
+  pthread_t		tid;
+  FILE			*in, *out, *err;
+  int			jobstatus;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base       = request;
+  iov.iov_len        = sizeof(request) - 1;
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  status = 1;
+
+  if ((bytes = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) <= 0)
+    goto done;
+
+  request[bytes] = '\0';
+
+  if (!strcmp(request, "ping\n"))
+  {
+    status = 0;
+    goto done;
+  }
+
+  for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+  {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(fds)))
+      memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+  }
+
+  // Request is "width tables\n"
+  if (fds[2] < 0 || (width = atoi(request)) <= 0 || (tables = strchr(request, ' ')) == NULL || !strchr(tables, '\n'))
+    goto done;
+
+  *strchr(++ tables, '\n') = '\0';
+
+  err = fdopen(fcntl(fds[2], F_DUPFD_CLOEXEC, 0), "w");
+
+  if (get_freedots(width, &job))
+  {
+    if (err)
+      fprintf(err, "DEBUG: freedots-worker: Unable to start FreeDots: %s\n", strerror(errno));
+  }
+  else if (write(sock, "S", 1) != 1)
+  {
+    // Client gone, nothing read or written yet
+    close(job.infd);
+    close(job.outfd);
+    kill(job.pid, SIGTERM);
+    waitpid(job.pid, NULL, 0);
+  }
+  else
+  {
+    copy.from = fds[0];
+    copy.to   = job.infd;
+
+    if (pthread_create(&tid, NULL, copy_input, &copy))
+    {
+      close(job.infd);
+      close(job.outfd);
+      kill(job.pid, SIGTERM);
+      waitpid(job.pid, NULL, 0);
+    }
+    else
+    {
+      in  = fdopen(job.outfd, "r");
+      out = fdopen(fcntl(fds[1], F_DUPFD_CLOEXEC, 0), "w");
+
+      if (in && out && translate(in, out, tables))
+	status = 0;
+      else if (err)
+	fprintf(err, "ERROR: freedots-worker: Unable to translate with %s\n", tables);
+
+      if (in)
+	fclose(in);
+      else
+	close(job.outfd);
+      if (out)
+	fclose(out);
+
+      pthread_join(tid, NULL);
+
+      if (waitpid(job.pid, &jobstatus, 0) < 0 || !WIFEXITED(jobstatus) || WEXITSTATUS(jobstatus))
+      {
+	if (err)
+	  fprintf(err, "ERROR: freedots-worker: FreeDots failed\n");
+	status = 1;
+      }
+    }
+  }
+
+  if (err)
+    fclose(err);
+
+  done:
+
+  if (write(sock, &status, 1) < 0)
+    status = 1;
+
+  for (i = 0; i < 3; i ++)
+    if (fds[i] >= 0)
+      close(fds[i]);
+
+  close(sock);
+
+  return (NULL);
+}
+
+
+//
+// 'connect_worker()' - Connect to the worker.
+//
+
+static int
+connect_worker(const char *path)
+{
+  struct sockaddr_un	addr;
+  int			sock;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path))
+    return (-1);
+  strcpy(addr.sun_path, path);
+
+  if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+    return (-1);
+
+  if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)))
+  {
+    close(sock);
+    return (-1);
+  }
+
+  return (sock);
+}
+
+
+//
+// 'client()' - Run a job or check the worker, return the exit status.
+//
+
+static int
+client(const char *path,
+       const char *request,
+       int passfds)
+{
+  int			sock, fds[3] = { 0, 1, 2 };
+  char			status = 1;
+  struct msghdr		msg;
+  struct iovec		iov;
+  union
+  {
+    struct cmsghdr	hdr;
+    char		buf[CMSG_SPACE(sizeof(fds))];
+  }			control;
+  struct cmsghdr	*cmsg;
+
+  if ((sock = connect_worker(path)) < 0)
+  {
+    fprintf(stderr, "DEBUG: freedots-worker: No worker on %s: %s\n", path, strerror(errno));
+    return (2);
+  }
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base   = (void *)request;
+  iov.iov_len    = strlen(request);
+  msg.msg_iov    = &iov;
+  msg.msg_iovlen = 1;
+
+  if (passfds)
+  {
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    cmsg               = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level   = SOL_SOCKET;
+    cmsg->cmsg_type    = SCM_RIGHTS;
+    cmsg->cmsg_len     = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  }
+
+  // The worker acknowledges a job before it touches its input or output,
+  // until then the caller can still run FreeDots itself
+  if (sendmsg(sock, &msg, 0) < 0 || (passfds && (read(sock, &status, 1) != 1 || status != 'S')))
+  {
+    fprintf(stderr, "DEBUG: freedots-worker: Worker did not start the job\n");
+    close(sock);
+    return (2);
+  }
+
+  if (read(sock, &status, 1) != 1)
+  {
+    fprintf(stderr, "ERROR: freedots-worker: Lost connection to worker: %s\n", strerror(errno));
+    status = 1;
+  }
+
+  close(sock);
+
+  return (status);
+}
+
+
+//
+// 'server()' - Accept and run jobs.
+//
+
+static int
+server(const char *path)
+{
+  struct sockaddr_un	addr;
+  int			sock, conn;
+  struct ucred		cred;
+  socklen_t		credlen;
+  pthread_t		tid;
+  pthread_attr_t	attr;
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGCHLD, SIG_DFL);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path))
+  {
+    fprintf(stderr, "ERROR: freedots-worker: Socket path too long\n");
+    return (1);
+  }
+  strcpy(addr.sun_path, path);
+
+  // Remove a stale socket, but not the one of a running worker
+  if ((sock = connect_worker(path)) >= 0)
+  {
+    fprintf(stderr, "ERROR: freedots-worker: Already running on %s\n", path);
+    close(sock);
+    return (1);
+  }
+  unlink(path);
+
+  // Nobody can connect before listen(), so the mode is set in time
+  if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) || chmod(path, 0660) || listen(sock, 16))
+  {
+    fprintf(stderr, "ERROR: freedots-worker: Unable to listen on %s: %s\n", path, strerror(errno));
+    return (1);
+  }
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  for (;;)
+  {
+    if ((conn = accept4(sock, NULL, NULL, SOCK_CLOEXEC)) < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+	continue;
+      fprintf(stderr, "ERROR: freedots-worker: Unable to accept connection: %s\n", strerror(errno));
+      return (1);
+    }
+
+    credlen  = sizeof(cred);
+    cred.uid = (uid_t)-1;
+    if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) || (cred.uid != 0 && cred.uid != geteuid() && cred.gid != getegid()))
+    {
+      fprintf(stderr, "ERROR: freedots-worker: Refused connection from UID %d\n", (int)cred.uid);
+      close(conn);
+      continue;
+    }
+
+    if (pthread_create(&tid, &attr, run_job, (void *)(long)conn))
+      close(conn);
+  }
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+  char	request[1024];
+
+  if (argc == 3 && !strcmp(argv[1], "-s"))
+    return (server(argv[2]));
+
+  if (argc == 3 && !strcmp(argv[1], "-p"))
+    return (client(argv[2], "ping\n", 0));
+
+  if (argc == 5 && !strcmp(argv[1], "-c") && atoi(argv[3]) > 0)
+  {
+    if (snprintf(request, sizeof(request), "%d %s\n", atoi(argv[3]), argv[4]) >= (int)sizeof(request))
+    {
+      fprintf(stderr, "ERROR: freedots-worker: Table list too long\n");
+      return (1);
+    }
+
+    return (client(argv[2], request, 1));
+  }
+
+  fprintf(stderr, "Usage: freedots-worker -s socket\n"
+		  "       freedots-worker -p socket\n"
+		  "       freedots-worker -c socket width tables\n");
+  return (1);
+}
@@ -0,0 +1,885 @@
+//
+// HTML to text renderer for the braille filters
+//
+// Copyright (c) 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage: htmltotext [-w width] [filename]
+//
+// Renders an HTML document as plain text lines of at most width cells
+// (default 80), like "lynx -dump" but without references and in a form
+// suited to braille: headings and paragraphs are separated by a blank line,
+// list items start with "*" or their number and are indented by nesting
+// level, table rows are written one per line with cells separated by "|",
+// preformatted text keeps its lines and image alternate texts are written
+// in brackets.  Scripts, styles and the document head are skipped.
+//
+// The document is parsed and laid out while it is read, only the current
+// word and line are kept, so memory use does not depend on the document
+// size.  Input is expected in UTF-8 (or ASCII), the width is counted in
+// characters.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+
+#define MAX_WIDTH	1000		// Max line width
+#define MAX_NESTING	32		// Max depth of indenting elements
+
+
+//
+// HTML parser state...
+//
+
+typedef enum
+{
+  HTML_TEXT,				// Character data
+  HTML_ENTITY,				// Entity reference
+  HTML_TAGOPEN,				// After '<'
+  HTML_TAG,				// Tag name
+  HTML_ATTRS,				// Attribute names, between attributes
+  HTML_ATTRVALUE,			// Attribute value
+  HTML_DECL,				// <! ... > or <? ... >
+  HTML_COMMENT,				// <!-- ... -->
+  HTML_RAWTEXT				// Content of script or style
+} html_state_t;
+
+typedef struct
+{
+  char		name[16];		// Element name
+  int		indent,			// Indent of content
+		number;			// Number of next list item, 0 for bullets
+} html_block_t;
+
+typedef struct
+{
+  // Parser
+  html_state_t	state;			// Parser state
+  char		name[16];		// Tag name
+  size_t	namelen;		// Length of tag name
+  int		closing;		// End tag?
+  char		attr[16];		// Attribute name
+  size_t	attrlen;		// Length of attribute name
+  char		quote;			// Quote of attribute value, or ' ' when unquoted
+  char		alt[256];		// Value of alt attribute
+  size_t	altlen;			// Length of alt value
+  int		inalt;			// Reading the alt value?
+  char		entity[32];		// Entity name
+  size_t	entitylen;		// Length of entity name
+  char		match[24];		// Matched part of end tag in raw text or comment
+  size_t	matchlen;		// Length matched
+
+  // Layout
+  int		width;			// Line width
+  char		*line;			// Current line
+  size_t	linelen;		// Length of line in bytes
+  int		col,			// Length of line in characters
+		started;		// Line started (indent written)?
+  char		word[4 * MAX_WIDTH + 4];// Current word
+  size_t	wordlen;		// Length of word in bytes
+  int		wordcols;		// Length of word in characters
+  int		space,			// Space pending before the word
+		blank;			// Blank lines pending, -1 at document start
+  char		prefix[16];		// List item marker for the next line
+  int		hang;			// Extra indent of item continuation lines
+  int		pre,			// In preformatted text? (2 at its start)
+		skip,			// In head, title...?
+		cells;			// Cells in the table row
+  html_block_t	blocks[MAX_NESTING];	// Open indenting elements
+  int		num_blocks,		// Number of open indenting elements
+		overflow;		// Number of ignored nested elements
+} html_t;
+
+
+//
+// Local functions...
+//
+
+static void	html_char(html_t *html, unsigned char c);
+
+
+//
+// 'html_indent()' - Indent of the current block.
+//
+
+static int
+html_indent(html_t *html)
+{
+  int indent = html->num_blocks ? html->blocks[html->num_blocks - 1].indent : 0;
+
+  return (indent > html->width / 2 ? html->width / 2 : indent);
+}
+
+
+//
+// 'html_endline()' - Write the current line.
+//
+
+static void
+html_endline(html_t *html)
+{
+  html->line[html->linelen ++] = '\n';
+  fwrite(html->line, 1, html->linelen, stdout);
+
+  html->linelen = 0;
+  html->col     = 0;
+  html->started = 0;
+}
+
+
+//
+// 'html_startline()' - Write pending blank lines and indent a new line.
+//
+
+static void
+html_startline(html_t *html)
+{
+  int		indent = html_indent(html);
+  size_t	len;
+
+  for (; html->blank > 0; html->blank --)
+    putchar('\n');
+  html->blank = 0;
+
+  if (html->prefix[0])
+  {
+    // First line of a list item: the text starts where the continuation
+    // lines do
+    len = strlen(html->prefix);
+    indent -= 2;
+    if (indent < 0)
+      indent = 0;
+  }
+  else
+  {
+    len = 0;
+    indent += html->hang;
+  }
+
+  memset(html->line, ' ', (size_t)indent);
+  memcpy(html->line + indent, html->prefix, len);
+
+  html->linelen   = (size_t)indent + len;
+  html->col       = indent + (int)len;
+  html->started   = 1;
+  html->prefix[0] = '\0';
+}
+
+
+//
+// 'html_putword()' - Add the current word to the line, wrapping as needed.
+//
+
+static void
+html_putword(html_t *html)
+{
+  int	space;
+
+  if (html->wordlen == 0)
+    return;
+
+  space = html->space && html->started && html->col > html_indent(html) + html->hang;
+
+  if (html->started && html->col + space + html->wordcols > html->width)
+  {
+    html_endline(html);
+    space = 0;
+  }
+
+  if (!html->started)
+    html_startline(html);
+
+  if (space)
+  {
+    html->line[html->linelen ++] = ' ';
+    html->col ++;
+  }
+
+  memcpy(html->line + html->linelen, html->word, html->wordlen);
+  html->linelen += html->wordlen;
+  html->col     += html->wordcols;
+
+  html->wordlen  = 0;
+  html->wordcols = 0;
+  html->space    = 0;
+}
+
+
+//
+// 'html_addbyte()' - Add a byte of text to the current word.
+//
+
+static void
+html_addbyte(html_t *html,
+             unsigned char c)
+{
+  if ((c & 0xc0) != 0x80)
+  {
+    // Break words which cannot fit on a line
+    if (html->wordcols >= html->width - html_indent(html) - html->hang)
+      html_putword(html);
+
+    html->wordcols ++;
+  }
+
+  if (html->wordlen < sizeof(html->word) - 1)
+    html->word[html->wordlen ++] = (char)c;
+}
+
+
+//
+// 'html_block()' - End the current block of text.
+//
+
+static void
+html_block(html_t *html,
+           int    blank)		// Blank lines wanted before next text
+{
+  html_putword(html);
+
+  if (html->started)
+    html_endline(html);
+
+  html->space = 0;
+
+  if (html->blank >= 0 && html->blank < blank)
+    html->blank = blank;
+}
+
+
+//
+// 'html_push()' - Open an indenting element.
+//
+
+static void
+html_push(html_t *html,
+          int    indent,		// Additional indent
+          int    number)		// First item number, 0 for bullets
+{
+  html_block_t	*block;
+
+  if (html->num_blocks >= MAX_NESTING)
+  {
+    html->overflow ++;
+    return;
+  }
+
+  block = html->blocks + html->num_blocks;
+  strncpy(block->name, html->name, sizeof(block->name) - 1);
+  block->name[sizeof(block->name) - 1] = '\0';
+  block->indent = html_indent(html) + indent;
+  block->number = number;
+
+  html->num_blocks ++;
+  html->hang = 0;
+}
+
+
+//
+// 'html_pop()' - Close an indenting element and the ones left open in it.
+//
+
+static void
+html_pop(html_t *html)
+{
+  int	i;
+
+  if (html->overflow > 0)
+  {
+    html->overflow --;
+    return;
+  }
+
+  for (i = html->num_blocks - 1; i >= 0; i --)
+  {
+    if (!strcmp(html->blocks[i].name, html->name))
+    {
+      html->num_blocks = i;
+      html->hang       = 0;
+      break;
+    }
+  }
+}
+
+
+//
+// 'html_text()' - Add a string to the text.
+//
+
+static void
+html_text(html_t     *html,
+          const char *s)
+{
+  while (*s)
+    html_char(html, (unsigned char)*s++);
+}
+
+
+//
+// 'html_tag()' - Handle the end of a start or end tag.
+//
+
+static void
+html_tag(html_t *html)
+{
+  const char	*name = html->name;
+  html_block_t	*list;
+  char		alt[sizeof(html->alt) + 2];
+
+  html->name[html->namelen] = '\0';
+  html->alt[html->altlen]   = '\0';
+
+  if (!strcmp(name, "script") || !strcmp(name, "style"))
+  {
+    if (!html->closing)
+    {
+      html->state    = HTML_RAWTEXT;
+      html->matchlen = 0;
+      snprintf(html->match, sizeof(html->match), "</%s", name);
+    }
+  }
+  else if (!strcmp(name, "head") || !strcmp(name, "title") || !strcmp(name, "template"))
+  {
+    if (!html->closing)
+      html->skip ++;
+    else if (html->skip > 0)
+      html->skip --;
+  }
+  else if (!strcmp(name, "body"))
+  {
+    // Unterminated head
+    html->skip = 0;
+  }
+  else if (html->skip)
+  {
+    return;
+  }
+  else if (!strcmp(name, "p") || (name[0] == 'h' && name[1] >= '1' && name[1] <= '6' && !name[2]))
+  {
+    html_block(html, 1);
+  }
+  else if (!strcmp(name, "br"))
+  {
+    html_putword(html);
+    if (!html->started)
+      html_startline(html);
+    html_endline(html);
+  }
+  else if (!strcmp(name, "hr") || !strcmp(name, "table") || !strcmp(name, "pre"))
+  {
+    html_block(html, 1);
+    if (!strcmp(name, "pre"))
+      html->pre = html->closing ? 0 : 2;
+  }
+  else if (!strcmp(name, "blockquote") || !strcmp(name, "dl"))
+  {
+    html_block(html, 1);
+    if (!html->closing)
+      html_push(html, 2, 0);
+    else
+      html_pop(html);
+  }
+  else if (!strcmp(name, "ul") || !strcmp(name, "ol") || !strcmp(name, "menu"))
+  {
+    // Nested lists are part of the item, top level lists are paragraphs
+    html_block(html, html->num_blocks ? 0 : 1);
+    if (!html->closing)
+      html_push(html, 2, name[0] == 'o' ? 1 : 0);
+    else
+      html_pop(html);
+  }
+  else if (!strcmp(name, "li"))
+  {
+    html_block(html, 0);
+    if (!html->closing)
+    {
+      list = html->num_blocks ? html->blocks + html->num_blocks - 1 : NULL;
+      if (list && list->number > 0)
+	snprintf(html->prefix, sizeof(html->prefix), "%d. ", list->number ++);
+      else
+	strcpy(html->prefix, "* ");
+      html->hang = (int)strlen(html->prefix) - 2;
+      if (html->hang < 0)
+	html->hang = 0;
+    }
+  }
+  else if (!strcmp(name, "dt") || !strcmp(name, "dd"))
+  {
+    html_block(html, 0);
+    if (html->num_blocks && !strcmp(html->blocks[html->num_blocks - 1].name, "dd"))
+      html->num_blocks --;
+    if (!html->closing && name[1] == 'd')
+      html_push(html, 2, 0);
+  }
+  else if (!strcmp(name, "tr") || !strcmp(name, "caption"))
+  {
+    html_block(html, 0);
+    html->cells = 0;
+  }
+  else if (!strcmp(name, "td") || !strcmp(name, "th"))
+  {
+    if (!html->closing && html->cells ++ > 0)
+    {
+      html_putword(html);
+      html->space = 1;
+      html_addbyte(html, '|');
+      html_putword(html);
+      html->space = 1;
+    }
+  }
+  else if (!strcmp(name, "div") || !strcmp(name, "section") || !strcmp(name, "article") || !strcmp(name, "header") || !strcmp(name, "footer") || !strcmp(name, "nav") || !strcmp(name, "main") || !strcmp(name, "aside") || !strcmp(name, "address") || !strcmp(name, "figure") || !strcmp(name, "figcaption") || !strcmp(name, "form") || !strcmp(name, "fieldset") || !strcmp(name, "center"))
+  {
+    html_block(html, 0);
+  }
+  else if (!strcmp(name, "img") && !html->closing && html->altlen > 0)
+  {
+    snprintf(alt, sizeof(alt), "[%s]", html->alt);
+    html->space = 1;
+    html_text(html, alt);
+    html->space = 1;
+  }
+}
+
+
+//
+// 'html_entity()' - Add a decoded entity to the text.
+//
+
+static void
+html_entity(html_t *html,
+            int    semicolon)		// Terminated by a semicolon?
+{
+  static const char * const latin1[] =	// Entities for U+00A0 to U+00FF
+  {
+    "nbsp", "iexcl", "cent", "pound", "curren", "yen", "brvbar", "sect",
+    "uml", "copy", "ordf", "laquo", "not", "shy", "reg", "macr",
+    "deg", "plusmn", "sup2", "sup3", "acute", "micro", "para", "middot",
+    "cedil", "sup1", "ordm", "raquo", "frac14", "frac12", "frac34", "iquest",
+    "Agrave", "Aacute", "Acirc", "Atilde", "Auml", "Aring", "AElig", "Ccedil",
+    "Egrave", "Eacute", "Ecirc", "Euml", "Igrave", "Iacute", "Icirc", "Iuml",
+    "ETH", "Ntilde", "Ograve", "Oacute", "Ocirc", "Otilde", "Ouml", "times",
+    "Oslash", "Ugrave", "Uacute", "Ucirc", "Uuml", "Yacute", "THORN", "szlig",
+    "agrave", "aacute", "acirc", "atilde", "auml", "aring", "aelig", "ccedil",
+    "egrave", "eacute", "ecirc", "euml", "igrave", "iacute", "icirc", "iuml",
+    "eth", "ntilde", "ograve", "oacute", "ocirc", "otilde", "ouml", "divide",
+    "oslash", "ugrave", "uacute", "ucirc", "uuml", "yacute", "thorn", "yuml"
+  };
+  static const struct
+  {
+    const char		*name;		// Entity name
+    unsigned long	ch;		// Character
+  }		entities[] =
+  {
+    { "amp", '&' },
+    { "lt", '<' },
+    { "gt", '>' },
+    { "quot", '\"' },
+    { "apos", '\'' },
+    { "ndash", 0x2013 },
+    { "mdash", 0x2014 },
+    { "lsquo", 0x2018 },
+    { "rsquo", 0x2019 },
+    { "ldquo", 0x201c },
+    { "rdquo", 0x201d },
+    { "bull", 0x2022 },
+    { "hellip", 0x2026 },
+    { "euro", 0x20ac },
+    { "trade", 0x2122 }
+  };
+  unsigned long	ch = 0;
+  size_t	i;
+  const char	*e = html->entity;
+  char		utf8[5];
+
+  html->entity[html->entitylen] = '\0';
+
+  if (e[0] == '#' && (e[1] == 'x' || e[1] == 'X'))
+    ch = strtoul(e + 2, NULL, 16);
+  else if (e[0] == '#')
+    ch = strtoul(e + 1, NULL, 10);
+  else
+  {
+    for (i = 0; i < sizeof(latin1) / sizeof(latin1[0]); i ++)
+    {
+      if (!strcmp(e, latin1[i]))
+      {
+	ch = 0xa0 + i;
+	break;
+      }
+    }
+
+    for (i = 0; !ch && i < sizeof(entities) / sizeof(entities[0]); i ++)
+    {
+      if (!strcmp(e, entities[i].name))
+	ch = entities[i].ch;
+    }
+  }
+
+  if (ch == 0 || ch > 0x10ffff)
+  {
+    // Unknown, keep it as is
+    html_addbyte(html, '&');
+    for (; *e; e ++)
+      html_addbyte(html, (unsigned char)*e);
+    if (semicolon)
+      html_addbyte(html, ';');
+    return;
+  }
+
+  if (ch == 0xa0)
+  {
+    // Non-breaking space
+    html_addbyte(html, ' ');
+    return;
+  }
+
+  if (ch == 0xad)
+    return;
+
+  if (ch < 0x80)
+  {
+    utf8[0] = (char)ch;
+    utf8[1] = '\0';
+  }
+  else if (ch < 0x800)
+  {
+    utf8[0] = (char)(0xc0 | (ch >> 6));
+    utf8[1] = (char)(0x80 | (ch & 0x3f));
+    utf8[2] = '\0';
+  }
+  else if (ch < 0x10000)
+  {
+    utf8[0] = (char)(0xe0 | (ch >> 12));
+    utf8[1] = (char)(0x80 | ((ch >> 6) & 0x3f));
+    utf8[2] = (char)(0x80 | (ch & 0x3f));
+    utf8[3] = '\0';
+  }
+  else
+  {
+    utf8[0] = (char)(0xf0 | (ch >> 18));
+    utf8[1] = (char)(0x80 | ((ch >> 12) & 0x3f));
+    utf8[2] = (char)(0x80 | ((ch >> 6) & 0x3f));
+    utf8[3] = (char)(0x80 | (ch & 0x3f));
+    utf8[4] = '\0';
+  }
+
+  for (e = utf8; *e; e ++)
+    html_addbyte(html, (unsigned char)*e);
+}
+
+
+//
+// 'html_textchar()' - Add a character of text, collapsing white space.
+//
+
+static void
+html_textchar(html_t        *html,
+              unsigned char c)
+{
+  if (html->skip)
+    return;
+
+  if (html->pre)
+  {
+    if (html->pre == 2)
+    {
+      // A newline right after <pre> is not part of the text
+      html->pre = 1;
+      if (c == '\n')
+	return;
+    }
+
+    if (c == '\n')
+    {
+      html_putword(html);
+      if (!html->started)
+	html_startline(html);
+      html_endline(html);
+    }
+    else if (c == '\t')
+    {
+      // Count the spaces first: the word may wrap while they are added, and
+      // with a deep indent the column never reaches the next tab stop
+      int n;
+
+      for (n = 8 - (html->col + html->wordcols) % 8; n > 0; n --)
+	html_addbyte(html, ' ');
+    }
+    else if (c != '\r')
+      html_addbyte(html, c);
+  }
+  else if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f')
+  {
+    html_putword(html);
+    html->space = 1;
+  }
+  else
+    html_addbyte(html, c);
+}
+
+
+//
+// 'html_char()' - Parse a character of HTML.
+//
+
+static void
+html_char(html_t        *html,
+          unsigned char c)
+{
+  switch (html->state)
+  {
+    case HTML_TEXT :
+	if (c == '<')
+	  html->state = HTML_TAGOPEN;
+	else if (c == '&' && !html->skip)
+	{
+	  html->state     = HTML_ENTITY;
+	  html->entitylen = 0;
+	}
+	else
+	  html_textchar(html, c);
+	break;
+
+    case HTML_ENTITY :
+	if (c == ';')
+	{
+	  html_entity(html, 1);
+	  html->state = HTML_TEXT;
+	}
+	else if (((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '#') && html->entitylen < sizeof(html->entity) - 1)
+	{
+	  html->entity[html->entitylen ++] = (char)c;
+	}
+	else
+	{
+	  // Not terminated, decode what we have and handle the character
+	  html_entity(html, 0);
+	  html->state = HTML_TEXT;
+	  html_char(html, c);
+	}
+	break;
+
+    case HTML_TAGOPEN :
+	html->namelen = 0;
+	html->closing = 0;
+	html->altlen  = 0;
+	html->inalt   = 0;
+	html->attrlen = 0;
+
+	if (c == '/')
+	  html->closing = 1;
+	if (c == '!' || c == '?')
+	{
+	  html->state    = HTML_DECL;
+	  html->matchlen = 0;
+	}
+	else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+	{
+	  html->state = HTML_TAG;
+	  html_char(html, c);
+	}
+	else if (c == '/')
+	  html->state = HTML_TAG;
+	else
+	{
+	  // Not a tag
+	  html->state = HTML_TEXT;
+	  html_textchar(html, '<');
+	  html_char(html, c);
+	}
+	break;
+
+    case HTML_TAG :
+	if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == ':')
+	{
+	  if (html->namelen < sizeof(html->name) - 1)
+	    html->name[html->namelen ++] = (char)(c | 0x20);
+	}
+	else
+	{
+	  html->state = HTML_ATTRS;
+	  html_char(html, c);
+	}
+	break;
+
+    case HTML_ATTRS :
+	if (c == '>')
+	{
+	  html->state = HTML_TEXT;
+	  html_tag(html);
+	}
+	else if (c == '=')
+	{
+	  html->state = HTML_ATTRVALUE;
+	  html->quote = '\0';
+	  html->inalt = html->attrlen == 3 && !strncasecmp(html->attr, "alt", 3);
+	}
+	else if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '/')
+	{
+	  if (html->attrlen > 0)
+	    html->attrlen = sizeof(html->attr);
+	}
+	else if (html->attrlen >= sizeof(html->attr))
+	{
+	  // Start of the next attribute name
+	  html->attr[0] = (char)c;
+	  html->attrlen = 1;
+	}
+	else if (html->attrlen < sizeof(html->attr) - 1)
+	  html->attr[html->attrlen ++] = (char)c;
+	break;
+
+    case HTML_ATTRVALUE :
+	if (!html->quote)
+	{
+	  // First character of the value
+	  if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+	    break;
+	  else if (c == '\"' || c == '\'')
+	  {
+	    html->quote = (char)c;
+	    break;
+	  }
+	  html->quote = ' ';
+	}
+
+	if (c == html->quote || (html->quote == ' ' && (c == '\t' || c == '\n' || c == '\r' || c == '>')))
+	{
+	  html->state   = HTML_ATTRS;
+	  html->attrlen = sizeof(html->attr);
+	  html->inalt   = 0;
+	  if (c == '>')
+	    html_char(html, c);
+	}
+	else if (html->inalt && html->altlen < sizeof(html->alt) - 1)
+	  html->alt[html->altlen ++] = (char)(c == '\n' || c == '\t' || c == '\r' ? ' ' : c);
+	break;
+
+    case HTML_DECL :
+	if (html->matchlen < 2 && c == '-')
+	{
+	  if (++ html->matchlen == 2)
+	  {
+	    html->state    = HTML_COMMENT;
+	    html->matchlen = 0;
+	  }
+	}
+	else if (c == '>')
+	  html->state = HTML_TEXT;
+	else
+	  html->matchlen = 2;
+	break;
+
+    case HTML_COMMENT :
+	if (c == '-')
+	  html->matchlen ++;
+	else if (c == '>' && html->matchlen >= 2)
+	  html->state = HTML_TEXT;
+	else
+	  html->matchlen = 0;
+	break;
+
+    case HTML_RAWTEXT :
+	// Look for the end tag
+	if (html->match[html->matchlen] && (c | (html->matchlen > 1 ? 0x20 : 0)) == html->match[html->matchlen])
+	{
+	  html->matchlen ++;
+	}
+	else if (!html->match[html->matchlen] && (c == '>' || c == ' ' || c == '\t' || c == '\n' || c == '/'))
+	{
+	  html->state   = c == '>' ? HTML_TEXT : HTML_ATTRS;
+	  html->closing = 1;
+	  html->altlen  = 0;
+	  html->attrlen = 0;
+	}
+	else
+	  html->matchlen = c == '<' ? 1 : 0;
+	break;
+  }
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+  const char	*filename = NULL;
+  int		width = 80;
+  int		fd = 0;
+  int		i;
+  html_t	*html;
+  unsigned char	buffer[65536];
+  ssize_t	bytes;
+  ssize_t	j;
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "-w") && i + 1 < argc)
+      width = atoi(argv[++ i]);
+    else if (!filename && argv[i][0] != '-')
+      filename = argv[i];
+    else
+      width = 0, i = argc;
+  }
+
+  if (width <= 0)
+  {
+    fprintf(stderr, "Usage: htmltotext [-w width] [filename]\n");
+    return (1);
+  }
+
+  if (width > MAX_WIDTH)
+    width = MAX_WIDTH;
+
+  if (filename && (fd = open(filename, O_RDONLY)) < 0)
+  {
+    fprintf(stderr, "ERROR: htmltotext: Unable to open %s: %s\n", filename, strerror(errno));
+    return (1);
+  }
+
+  if ((html = calloc(1, sizeof(html_t))) == NULL || (html->line = malloc(sizeof(html->word) + 32)) == NULL)
+  {
+    fprintf(stderr, "ERROR: htmltotext: Unable to allocate memory\n");
+    return (1);
+  }
+
+  html->width = width;
+  html->blank = -1;
+
+  while ((bytes = read(fd, buffer, sizeof(buffer))) != 0)
+  {
+    if (bytes < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+	continue;
+      fprintf(stderr, "ERROR: htmltotext: Unable to read input: %s\n", strerror(errno));
+      return (1);
+    }
+
+    for (j = 0; j < bytes; j ++)
+      html_char(html, buffer[j]);
+  }
+
+  if (html->state == HTML_ENTITY)
+    html_entity(html, 0);
+  html_block(html, 0);
+
+  if (fflush(stdout) || ferror(stdout))
+  {
+    fprintf(stderr, "ERROR: htmltotext: Unable to write output: %s\n", strerror(errno));
+    return (1);
+  }
+
+  free(html->line);
+  free(html);
+
+  return (0);
+}
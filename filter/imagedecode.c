@@ -0,0 +1,917 @@
+//
+// Reduced resolution image decoder for the braille filters
+//
+// Copyright (c) 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage: imagedecode [-j threads] -s size [filename]
+//
+// Writes a JPEG, PNG or TIFF image as a grayscale PGM image whose longest side is
+// at least size pixels, but not much more: embossed graphics are a few
+// hundred dots wide, while photos are often tens of megapixels.  The
+// decoders only do the work needed for that size:
+//
+// - JPEG images are decoded with DCT scaling (1/8 to 8/8), which skips most
+//   of the inverse DCT and color conversion,
+// - interlaced PNG images are decoded from the first Adam7 passes only,
+//   which hold the image at 1/8, 1/4 or 1/2 resolution,
+// - other PNG images are decoded row by row,
+// - TIFF images are decoded from the smallest reduced resolution copy which
+//   is large enough, in bands of whole strips or tiles shared by a thread
+//   per CPU by default (when the input is a named file).
+//
+// The decoded rows are then averaged over square boxes down to the wanted
+// size while they come, so memory use does not depend on the image size
+// (except for the passes of an interlaced PNG, and the strips or tiles of a
+// TIFF, up to MAX_MEMORY).  Transparent pixels are
+// flattened on white.
+//
+// Other images, and JPEG images in CMYK, are copied unchanged, so the
+// output can always be given to ImageMagick.  The input must be seekable
+// for that, a pipe is always copied unchanged.
+//
+
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <jpeglib.h>
+#include <png.h>
+#ifdef HAVE_LIBTIFF
+#  include <pthread.h>
+#  include <stdarg.h>
+#  include <stdint.h>
+#  include <tiffio.h>
+#endif // HAVE_LIBTIFF
+
+
+#define BAND_ROWS	12		// Min output rows per band (3 and 4 dot cells)
+#define MAX_BLOCK	(64 << 20)	// Max memory for a row of TIFF strips/tiles
+#define MAX_MEMORY	(256 << 20)	// Max memory for all TIFF threads
+#define MAX_THREADS	16		// Max TIFF decoding threads
+
+
+//
+// Box scaler state...
+//
+
+typedef struct
+{
+  unsigned	factor,			// Box size
+		width,			// Output width
+		height,			// Output height
+		rows,			// Input rows in the sums
+		outrows;		// Output rows written
+  unsigned	*sums;			// Sums of the pixels of each box
+  unsigned char	*out;			// Output row
+} scaler_t;
+
+typedef struct
+{
+  struct jpeg_error_mgr	pub;		// libjpeg error manager
+  jmp_buf		env;		// Where to go on error
+} jpeg_error_t;
+
+#ifdef HAVE_LIBTIFF
+typedef struct
+{
+  const char	*filename;		// File to open in each thread
+  const char	*mode;			// Mode to open it with
+  TIFF		*tif;			// Open handle, for the first thread
+  unsigned	size;			// Wanted size
+  tdir_t	dir;			// Image to decode
+  uint64_t	subifd;			// SubIFD of the image or 0
+  uint32_t	width,			// Image width
+		height,			// Image height
+		tile_width,		// Width of a tile or strip
+		block_rows;		// Rows per tile or strip
+  int		tiled;			// Tiled image?
+  unsigned	factor,			// Box size
+		outwidth,		// Output width
+		outheight,		// Output height
+		band_rows,		// Output rows per band
+		next_band;		// Next band to decode
+  unsigned char	*out;			// Output image
+  int		failed;			// Did a thread fail?
+  pthread_mutex_t mutex;		// Mutex for the bands
+} tiff_job_t;
+#endif // HAVE_LIBTIFF
+
+
+//
+// 'scale_start()' - Choose the box size and write the PGM header.
+//
+
+static int
+scale_start(scaler_t *s,
+	    unsigned width,
+	    unsigned height,
+	    unsigned size)
+{
+  unsigned longest = width > height ? width : height;
+  unsigned shortest = width > height ? height : width;
+
+  s->factor = longest / size;
+  if (s->factor > shortest)
+    s->factor = shortest;
+  if (s->factor < 1)
+    s->factor = 1;
+
+  s->width   = width / s->factor;
+  s->height  = height / s->factor;
+  s->rows    = 0;
+  s->outrows = 0;
+
+  if ((s->sums = calloc(s->width, sizeof(unsigned))) == NULL || (s->out = malloc(s->width)) == NULL)
+  {
+    fprintf(stderr, "ERROR: imagedecode: Unable to allocate memory\n");
+    return (-1);
+  }
+
+  fprintf(stderr, "DEBUG: imagedecode: %ux%u decoded, %ux%u written\n", width, height, s->width, s->height);
+
+  printf("P5\n%u %u\n255\n", s->width, s->height);
+
+  return (0);
+}
+
+
+//
+// 'scale_row()' - Add a row of gray pixels.
+//
+
+static void
+scale_row(scaler_t            *s,
+	  const unsigned char *row)
+{
+  unsigned	x, i;
+  unsigned	*sum;
+
+  if (s->outrows >= s->height)
+    return;
+
+  for (x = 0, sum = s->sums; x < s->width; x ++, sum ++)
+    for (i = 0; i < s->factor; i ++)
+      *sum += *row++;
+
+  if (++ s->rows == s->factor)
+  {
+    for (x = 0; x < s->width; x ++)
+    {
+      s->out[x]  = (unsigned char)(s->sums[x] / (s->factor * s->factor));
+      s->sums[x] = 0;
+    }
+
+    fwrite(s->out, 1, s->width, stdout);
+
+    s->rows = 0;
+    s->outrows ++;
+  }
+}
+
+
+//
+// 'scale_end()' - Release the scaler.
+//
+
+static void
+scale_end(scaler_t *s)
+{
+  free(s->sums);
+  free(s->out);
+}
+
+
+//
+// 'jpeg_error()' - Handle a libjpeg error.
+//
+
+static void
+jpeg_error(j_common_ptr cinfo)
+{
+  jpeg_error_t	*err = (jpeg_error_t *)cinfo->err;
+  char		message[JMSG_LENGTH_MAX];
+
+  (*cinfo->err->format_message)(cinfo, message);
+  fprintf(stderr, "ERROR: imagedecode: %s\n", message);
+
+  longjmp(err->env, 1);
+}
+
+
+//
+// 'decode_jpeg()' - Decode a JPEG image.
+//
+// Returns 0 on success, 1 on error and -1 when the image is not supported
+// (nothing was written).
+//
+
+static int
+decode_jpeg(FILE     *fp,
+	    unsigned size)
+{
+  struct jpeg_decompress_struct	cinfo;
+  jpeg_error_t			jerr;
+  scaler_t			s;
+  JSAMPROW			row = NULL;
+  unsigned			longest, num;
+  volatile int			started = 0;
+
+  memset(&s, 0, sizeof(s));
+
+  cinfo.err           = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = jpeg_error;
+
+  if (setjmp(jerr.env))
+  {
+    jpeg_destroy_decompress(&cinfo);
+    free(row);
+    scale_end(&s);
+    return (started ? 1 : -1);
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_stdio_src(&cinfo, fp);
+  jpeg_read_header(&cinfo, TRUE);
+
+  if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK)
+  {
+    jpeg_destroy_decompress(&cinfo);
+    return (-1);
+  }
+
+  // Smallest DCT scaling which gives at least the wanted size
+  longest = cinfo.image_width > cinfo.image_height ? cinfo.image_width : cinfo.image_height;
+  for (num = 1; num < 8 && longest * num < 8 * size; num ++);
+
+  cinfo.scale_num           = num;
+  cinfo.scale_denom         = 8;
+  cinfo.out_color_space     = JCS_GRAYSCALE;
+  cinfo.dct_method          = JDCT_IFAST;
+  cinfo.do_fancy_upsampling = FALSE;
+
+  jpeg_start_decompress(&cinfo);
+
+  if ((row = malloc(cinfo.output_width)) == NULL || scale_start(&s, cinfo.output_width, cinfo.output_height, size))
+    longjmp(jerr.env, 1);
+
+  started = 1;
+
+  while (cinfo.output_scanline < cinfo.output_height && s.outrows < s.height)
+  {
+    jpeg_read_scanlines(&cinfo, &row, 1);
+    scale_row(&s, row);
+  }
+
+  // The rest of the image is not needed
+  jpeg_destroy_decompress(&cinfo);
+  free(row);
+  scale_end(&s);
+
+  return (0);
+}
+
+
+//
+// 'flatten()' - Convert gray and alpha pixels to gray on white.
+//
+
+static void
+flatten(unsigned char *row,
+	unsigned      width)
+{
+  unsigned	x;
+  unsigned char	*in = row;
+
+  for (x = 0; x < width; x ++, in += 2)
+    row[x] = (unsigned char)((in[0] * in[1] + 255 * (255 - in[1])) / 255);
+}
+
+
+//
+// 'decode_png()' - Decode a PNG image.
+//
+// Returns 0 on success, 1 on error and -1 when the image is not supported
+// (nothing was written).
+//
+
+static int
+decode_png(FILE     *fp,
+	   unsigned size)
+{
+  png_structp		png;
+  png_infop		info;
+  png_uint_32		width, height;
+  int			depth, color, interlace, channels;
+  unsigned		step, gwidth, gheight, y, x, c;
+  int			pass, last;
+  png_uint_32		prows, pcols, r;
+  scaler_t		s;
+  unsigned char		* volatile row = NULL,
+			* volatile grid = NULL;
+  volatile int		started = 0;
+
+  memset(&s, 0, sizeof(s));
+
+  if ((png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL)) == NULL)
+    return (-1);
+
+  if ((info = png_create_info_struct(png)) == NULL)
+  {
+    png_destroy_read_struct(&png, NULL, NULL);
+    return (-1);
+  }
+
+  if (setjmp(png_jmpbuf(png)))
+  {
+    png_destroy_read_struct(&png, &info, NULL);
+    free(row);
+    free(grid);
+    scale_end(&s);
+    return (started ? 1 : -1);
+  }
+
+  png_init_io(png, fp);
+  png_read_info(png, info);
+  png_get_IHDR(png, info, &width, &height, &depth, &color, &interlace, NULL, NULL);
+
+  png_set_expand(png);
+  png_set_strip_16(png);
+  if (color & PNG_COLOR_MASK_COLOR)
+    png_set_rgb_to_gray_fixed(png, 1, -1, -1);
+  png_read_update_info(png, info);
+
+  channels = png_get_channels(png, info);
+
+  if ((row = malloc(png_get_rowbytes(png, info))) == NULL)
+    png_error(png, "Unable to allocate memory");
+
+  if (interlace != PNG_INTERLACE_ADAM7)
+  {
+    // Decode rows as they come
+    if (scale_start(&s, width, height, size))
+      png_error(png, "Unable to allocate memory");
+    started = 1;
+
+    for (y = 0; y < height && s.outrows < s.height; y ++)
+    {
+      png_read_row(png, row, NULL);
+      if (channels == 2)
+	flatten(row, width);
+      scale_row(&s, row);
+    }
+  }
+  else
+  {
+    // Passes 0, 0-2 and 0-4 hold every 8th, 4th and 2nd pixel of every
+    // 8th, 4th and 2nd row; collect the pixels of the coarsest grid which
+    // is large enough
+    for (step = 8; step > 1; step /= 2)
+      if (((width > height ? width : height) + step - 1) / step >= size)
+	break;
+
+    last    = step == 8 ? 0 : step == 4 ? 2 : step == 2 ? 4 : 6;
+    gwidth  = (width + step - 1) / step;
+    gheight = (height + step - 1) / step;
+
+    if ((grid = malloc((size_t)gwidth * gheight)) == NULL)
+      png_error(png, "Unable to allocate memory");
+
+    for (pass = 0; pass <= last; pass ++)
+    {
+      prows = PNG_PASS_ROWS(height, pass);
+      pcols = PNG_PASS_COLS(width, pass);
+
+      if (prows == 0 || pcols == 0)
+	continue;
+
+      for (r = 0; r < prows; r ++)
+      {
+	png_read_row(png, row, NULL);
+	if (channels == 2)
+	  flatten(row, pcols);
+
+	if ((y = PNG_ROW_FROM_PASS_ROW(r, pass)) % step)
+	  continue;
+
+	for (c = 0; c < pcols; c ++)
+	{
+	  if ((x = PNG_COL_FROM_PASS_COL(c, pass)) % step == 0)
+	    grid[(y / step) * gwidth + x / step] = row[c];
+	}
+      }
+    }
+
+    if (scale_start(&s, gwidth, gheight, size))
+      png_error(png, "Unable to allocate memory");
+    started = 1;
+
+    for (y = 0; y < gheight; y ++)
+      scale_row(&s, grid + (size_t)y * gwidth);
+  }
+
+  // The rest of the image is not needed
+  png_destroy_read_struct(&png, &info, NULL);
+  free(row);
+  free(grid);
+  scale_end(&s);
+
+  return (0);
+}
+
+
+#ifdef HAVE_LIBTIFF
+//
+// 'tiff_error()' - Report a libtiff error.
+//
+
+static void
+tiff_error(const char *module,
+	   const char *format,
+	   va_list    ap)
+{
+  char	message[1024];
+
+  vsnprintf(message, sizeof(message), format, ap);
+  fprintf(stderr, "ERROR: imagedecode: %s%s%s\n", module ? module : "", module ? ": " : "", message);
+}
+
+
+//
+// 'tiff_open()' - Go to the selected image and get its layout.
+//
+
+static int
+tiff_open(TIFF       *tif,
+	  tiff_job_t *job)
+{
+  char	message[1024];
+
+  if (!TIFFSetDirectory(tif, job->dir) || (job->subifd && !TIFFSetSubDirectory(tif, job->subifd)))
+    return (-1);
+
+  if (!TIFFRGBAImageOK(tif, message))
+  {
+    fprintf(stderr, "DEBUG: imagedecode: %s\n", message);
+    return (-1);
+  }
+
+  if ((job->tiled = TIFFIsTiled(tif)) != 0)
+  {
+    TIFFGetField(tif, TIFFTAG_TILEWIDTH, &job->tile_width);
+    TIFFGetField(tif, TIFFTAG_TILELENGTH, &job->block_rows);
+  }
+  else
+  {
+    job->tile_width = job->width;
+    TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &job->block_rows);
+    if (job->block_rows > job->height)
+      job->block_rows = job->height;
+  }
+
+  return (0);
+}
+
+
+//
+// 'tiff_select()' - Select the image of a TIFF file to decode.
+//
+// Scanned maps usually come with reduced resolution copies, either as
+// reduced images following the first one or as SubIFDs of it; the smallest
+// one which still has the wanted size is decoded.
+//
+
+static int
+tiff_select(TIFF       *tif,
+	    tiff_job_t *job)
+{
+  uint32_t	width, height, type;
+  uint16_t	i, count = 0;
+  uint64_t	*offsets = NULL,
+		*subifds = NULL;
+  tdir_t	dir;
+
+  if (!TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &job->width) || !TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &job->height))
+    return (-1);
+
+  job->dir    = 0;
+  job->subifd = 0;
+
+  // SubIFDs of the first image
+  if (TIFFGetField(tif, TIFFTAG_SUBIFD, &count, &offsets) && count > 0 && (subifds = malloc(count * sizeof(uint64_t))) != NULL)
+  {
+    // The array is owned by the directory we are about to leave...
+    memcpy(subifds, offsets, count * sizeof(uint64_t));
+
+    for (i = 0; i < count; i ++)
+    {
+      if (!TIFFSetSubDirectory(tif, subifds[i]) || !TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width) || !TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height))
+	continue;
+
+      if ((width > height ? width : height) >= job->size && width < job->width)
+      {
+	job->width  = width;
+	job->height = height;
+	job->subifd = subifds[i];
+      }
+    }
+
+    free(subifds);
+  }
+
+  // Reduced images following the first one
+  for (dir = 1; TIFFSetDirectory(tif, dir); dir ++)
+  {
+    if (!TIFFGetField(tif, TIFFTAG_SUBFILETYPE, &type) || !(type & FILETYPE_REDUCEDIMAGE))
+      break;
+
+    if (!TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width) || !TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height))
+      break;
+
+    if ((width > height ? width : height) >= job->size && width < job->width)
+    {
+      job->width  = width;
+      job->height = height;
+      job->dir    = dir;
+      job->subifd = 0;
+    }
+  }
+
+  return (tiff_open(tif, job));
+}
+
+
+//
+// 'tiff_block()' - Decode a row of strips or tiles as gray pixels.
+//
+
+static int
+tiff_block(TIFF          *tif,
+	   tiff_job_t    *job,
+	   uint32_t      *raster,
+	   unsigned char *gray,
+	   uint32_t      y)
+{
+  uint32_t	rows, x, tx, r, c, p;
+  unsigned	v;
+  unsigned char	*out;
+
+  rows = job->height - y < job->block_rows ? job->height - y : job->block_rows;
+
+  for (tx = 0; tx < job->width; tx += job->tile_width)
+  {
+    if (job->tiled ? !TIFFReadRGBATile(tif, tx, y, raster) : !TIFFReadRGBAStrip(tif, y, raster))
+      return (-1);
+
+    // The raster starts with the bottom row: strips hold the rows read,
+    // tiles always hold block_rows rows
+    for (r = 0; r < rows; r ++)
+    {
+      const uint32_t *in = raster + (size_t)((job->tiled ? job->block_rows : rows) - 1 - r) * job->tile_width;
+
+      out = gray + (size_t)r * job->width + tx;
+
+      for (c = 0, x = tx; c < job->tile_width && x < job->width; c ++, x ++)
+      {
+	p = in[c];
+	// The RGBA interface premultiplies the alpha
+	v = ((77 * TIFFGetR(p) + 150 * TIFFGetG(p) + 29 * TIFFGetB(p)) >> 8) + 255 - TIFFGetA(p);
+	*out++ = (unsigned char)(v > 255 ? 255 : v);
+      }
+    }
+  }
+
+  return (0);
+}
+
+
+//
+// 'tiff_worker()' - Decode bands of output rows until none are left.
+//
+
+static void *
+tiff_worker(void *data)
+{
+  tiff_job_t	*job = (tiff_job_t *)data;
+  TIFF		*tif;
+  uint32_t	*raster = NULL;
+  unsigned char	*gray = NULL;
+  unsigned	*sums = NULL;
+  unsigned	band, outy, last, x, i, f = job->factor;
+  uint32_t	y, block = (uint32_t)-1;
+  const unsigned char *row;
+  int		failed = 0;
+
+  pthread_mutex_lock(&job->mutex);
+  tif = job->tif;
+  job->tif = NULL;
+  pthread_mutex_unlock(&job->mutex);
+
+  if (!tif && ((tif = TIFFOpen(job->filename, job->mode)) == NULL || tiff_open(tif, job)))
+    failed = 1;
+  else if ((raster = malloc((size_t)job->tile_width * job->block_rows * sizeof(uint32_t))) == NULL ||
+	   (gray = malloc((size_t)job->width * job->block_rows)) == NULL ||
+	   (sums = malloc(job->outwidth * sizeof(unsigned))) == NULL)
+    failed = 1;
+
+  while (!failed)
+  {
+    pthread_mutex_lock(&job->mutex);
+    failed = job->failed;
+    band   = job->next_band ++;
+    pthread_mutex_unlock(&job->mutex);
+
+    if (failed || band * job->band_rows >= job->outheight)
+      break;
+
+    outy = band * job->band_rows;
+    last = outy + job->band_rows > job->outheight ? job->outheight : outy + job->band_rows;
+
+    for (; outy < last && !failed; outy ++)
+    {
+      memset(sums, 0, job->outwidth * sizeof(unsigned));
+
+      for (y = outy * f; y < (outy + 1) * f; y ++)
+      {
+	// Bands start on any row, so a block may be decoded by two threads
+	if (y / job->block_rows != block)
+	{
+	  block = y / job->block_rows;
+	  if (tiff_block(tif, job, raster, gray, block * job->block_rows))
+	  {
+	    failed = 1;
+	    break;
+	  }
+	}
+
+	row = gray + (size_t)(y - block * job->block_rows) * job->width;
+	for (x = 0; x < job->outwidth; x ++)
+	  for (i = 0; i < f; i ++)
+	    sums[x] += *row++;
+      }
+
+      for (x = 0; x < job->outwidth; x ++)
+	job->out[(size_t)outy * job->outwidth + x] = (unsigned char)(sums[x] / (f * f));
+    }
+  }
+
+  if (failed)
+  {
+    pthread_mutex_lock(&job->mutex);
+    job->failed = 1;
+    pthread_mutex_unlock(&job->mutex);
+  }
+
+  if (tif)
+    TIFFClose(tif);
+  free(raster);
+  free(gray);
+  free(sums);
+
+  return (NULL);
+}
+
+
+//
+// 'decode_tiff()' - Decode a TIFF image.
+//
+// Returns 0 on success, 1 on error and -1 when the image is not supported
+// (nothing was written).
+//
+
+static int
+decode_tiff(int        fd,
+	    const char *filename,
+	    unsigned   size,
+	    int        num_threads)
+{
+  tiff_job_t	job;
+  scaler_t	s;
+  pthread_t	threads[MAX_THREADS];
+  int		i, tfd;
+  size_t	block;
+
+  memset(&job, 0, sizeof(job));
+  memset(&s, 0, sizeof(s));
+
+  TIFFSetErrorHandler(tiff_error);
+  TIFFSetWarningHandler(NULL);
+
+  job.filename = filename;
+  job.size     = size;
+
+  // Files are read rather than mapped ("m") so that memory use stays
+  // bounded, except for tiled images: libtiff 4.5 fails to read RGBA tiles
+  // from files which are not mapped
+  for (job.mode = "rm";; job.mode = "r")
+  {
+    // libtiff closes the descriptor it is given
+    if ((tfd = dup(fd)) < 0)
+      return (-1);
+
+    if (lseek(tfd, 0, SEEK_SET) < 0 || (job.tif = TIFFFdOpen(tfd, filename ? filename : "-", job.mode)) == NULL)
+    {
+      close(tfd);
+      return (-1);
+    }
+
+    if (tiff_select(job.tif, &job))
+    {
+      TIFFClose(job.tif);
+      return (-1);
+    }
+
+    if (!job.tiled || !strcmp(job.mode, "r"))
+      break;
+
+    TIFFClose(job.tif);
+  }
+
+  // Memory for one row of strips or tiles, in RGBA and in gray
+  block = ((size_t)job.tile_width * 4 + job.width) * job.block_rows;
+
+  if (block > MAX_BLOCK)
+  {
+    // A compressed image in a single huge strip, let ImageMagick do it
+    fprintf(stderr, "DEBUG: imagedecode: %ux%u TIFF with %u rows per strip\n", job.width, job.height, job.block_rows);
+    TIFFClose(job.tif);
+    return (-1);
+  }
+
+  if (scale_start(&s, job.width, job.height, size))
+  {
+    TIFFClose(job.tif);
+    return (1);
+  }
+
+  job.factor    = s.factor;
+  job.outwidth  = s.width;
+  job.outheight = s.height;
+
+  if ((job.out = malloc((size_t)s.width * s.height)) == NULL)
+  {
+    fprintf(stderr, "ERROR: imagedecode: Unable to allocate memory\n");
+    TIFFClose(job.tif);
+    scale_end(&s);
+    return (1);
+  }
+
+  // Bands of output rows which cover whole strips or tiles, each thread
+  // opening the file for itself since a TIFF handle is not thread safe
+  job.band_rows = (job.block_rows + s.factor - 1) / s.factor;
+  if (job.band_rows < BAND_ROWS)
+    job.band_rows = BAND_ROWS;
+
+  if (!filename)
+    num_threads = 1;
+  else if (num_threads <= 0)
+    num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (num_threads > MAX_THREADS)
+    num_threads = MAX_THREADS;
+  if ((size_t)num_threads * block > MAX_MEMORY)
+    num_threads = (int)(MAX_MEMORY / block);
+  if ((unsigned)num_threads > (s.height + job.band_rows - 1) / job.band_rows)
+    num_threads = (int)((s.height + job.band_rows - 1) / job.band_rows);
+  if (num_threads < 1)
+    num_threads = 1;
+
+  fprintf(stderr, "DEBUG: imagedecode: TIFF image %u.%llu, %u rows per %s, %d threads\n", (unsigned)job.dir, (unsigned long long)job.subifd, job.block_rows, job.tiled ? "tile" : "strip", num_threads);
+
+  pthread_mutex_init(&job.mutex, NULL);
+
+  for (i = 1; i < num_threads; i ++)
+  {
+    if (pthread_create(threads + i, NULL, tiff_worker, &job))
+      break;
+  }
+
+  num_threads = i;
+  tiff_worker(&job);
+
+  for (i = 1; i < num_threads; i ++)
+    pthread_join(threads[i], NULL);
+
+  pthread_mutex_destroy(&job.mutex);
+
+  if (!job.failed)
+    fwrite(job.out, 1, (size_t)s.width * s.height, stdout);
+
+  free(job.out);
+  scale_end(&s);
+
+  return (job.failed);
+}
+#endif // HAVE_LIBTIFF
+
+
+//
+// 'copy()' - Copy the input unchanged.
+//
+
+static int
+copy(int fd)
+{
+  char		buffer[65536];
+  ssize_t	bytes;
+
+  while ((bytes = read(fd, buffer, sizeof(buffer))) != 0)
+  {
+    if (bytes < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+	continue;
+      fprintf(stderr, "ERROR: imagedecode: Unable to read input: %s\n", strerror(errno));
+      return (1);
+    }
+
+    if (fwrite(buffer, 1, (size_t)bytes, stdout) != (size_t)bytes)
+      break;
+  }
+
+  return (0);
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+  const char	*filename = NULL;
+  int		size = 0;
+  int		num_threads = 0;
+  int		fd = 0;
+  int		i;
+  unsigned char	magic[8];
+  ssize_t	bytes = 0;
+  FILE		*fp;
+  int		status = -1;
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "-s") && i + 1 < argc)
+      size = atoi(argv[++ i]);
+    else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+      num_threads = atoi(argv[++ i]);
+    else if (!filename && argv[i][0] != '-')
+      filename = argv[i];
+    else
+      size = 0, i = argc;
+  }
+
+  if (size <= 0)
+  {
+    fprintf(stderr, "Usage: imagedecode [-j threads] -s size [filename]\n");
+    return (1);
+  }
+
+  if (filename && (fd = open(filename, O_RDONLY)) < 0)
+  {
+    fprintf(stderr, "ERROR: imagedecode: Unable to open %s: %s\n", filename, strerror(errno));
+    return (1);
+  }
+
+  if (lseek(fd, 0, SEEK_CUR) < 0)
+    return (copy(fd));
+
+  while (bytes < (ssize_t)sizeof(magic) && (i = (int)read(fd, magic + bytes, sizeof(magic) - (size_t)bytes)) > 0)
+    bytes += i;
+
+  if (lseek(fd, 0, SEEK_SET) < 0 || (fp = fdopen(fd, "rb")) == NULL)
+    return (copy(fd));
+
+  if (bytes >= 3 && magic[0] == 0xff && magic[1] == 0xd8 && magic[2] == 0xff)
+    status = decode_jpeg(fp, (unsigned)size);
+  else if (bytes == sizeof(magic) && !png_sig_cmp(magic, 0, sizeof(magic)))
+    status = decode_png(fp, (unsigned)size);
+#ifdef HAVE_LIBTIFF
+  else if (bytes >= 4 && (!memcmp(magic, "II*", 4) || !memcmp(magic, "MM\0*", 4) || !memcmp(magic, "II+", 4) || !memcmp(magic, "MM\0+", 4)))
+    status = decode_tiff(fd, filename, (unsigned)size, num_threads);
+#else
+  (void)num_threads;
+#endif // HAVE_LIBTIFF
+
+  if (status < 0)
+  {
+    fprintf(stderr, "DEBUG: imagedecode: Not decoded, copying the image\n");
+    if (lseek(fd, 0, SEEK_SET) < 0)
+    {
+      fprintf(stderr, "ERROR: imagedecode: Unable to rewind input: %s\n", strerror(errno));
+      return (1);
+    }
+    status = copy(fd);
+  }
+
+  if (fflush(stdout) || ferror(stdout))
+  {
+    fprintf(stderr, "ERROR: imagedecode: Unable to write output: %s\n", strerror(errno));
+    return (1);
+  }
+
+  return (status);
+}
@@ -0,0 +1,529 @@
+//
+// Dot grid to braille filter
+//
+// Copyright (c) 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage: pbmtobrf [-n] [-r 0|90|180|270] [-m] [-t] [-u] -p WxH+X+Y [filename]
+//
+// Reads a raw PBM image with one pixel per braille dot, negates it (-n),
+// rotates it clockwise by the given angle (-r), mirrors it left to right
+// (-m), widens its lines by one dot to the right and down (-t), places it at
+// X,Y on a blank page of WxH dots (-p) and writes the page as BRF (6 dots
+// per cell) or, with -u, as Unicode braille (8 dots per cell), like
+// ImageMagick's "brf:" and "ubrl:" output does.  Black pixels are raised
+// dots.  Several concatenated images (as written by Ghostscript for a
+// multi-page document) give pages separated by form feeds.
+//
+// The image is kept packed at one bit per dot.  Rotations are done with
+// transposes of 8x8 bit blocks held in a 64-bit word, plus reversing the
+// order of rows or of the bits in rows, so they cost next to nothing even
+// for a whole page.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+//
+// Packed bitmap...
+//
+
+typedef struct
+{
+  unsigned	width,			// Width in dots
+		height,			// Height in dots
+		stride;			// Bytes per row
+  unsigned char	*bits;			// Rows, MSB first, 1 = dot
+} bitmap_t;
+
+
+//
+// BRF characters for the 64 combinations of dots 1 to 6...
+//
+
+static const char brf[64] =
+{
+  ' ', 'A', '1', 'B', '\'', 'K', '2', 'L',
+  '@', 'C', 'I', 'F', '/', 'M', 'S', 'P',
+  '\"', 'E', '3', 'H', '9', 'O', '6', 'R',
+  '^', 'D', 'J', 'G', '>', 'N', 'T', 'Q',
+  ',', '*', '5', '<', '-', 'U', '8', 'V',
+  '.', '%', '[', '$', '+', 'X', '!', '&',
+  ';', ':', '4', '\\', '0', 'Z', '7', '(',
+  '_', '?', 'W', ']', '#', 'Y', ')', '='
+};
+
+
+//
+// 'bitmap_new()' - Allocate a blank bitmap.
+//
+// The rows are allocated up to a multiple of 8 so that 8x8 blocks can be
+// read and written without bound checks, the padding is kept blank.
+//
+
+static int
+bitmap_new(bitmap_t *bm,
+           unsigned width,
+           unsigned height)
+{
+  bm->width  = width;
+  bm->height = height;
+  bm->stride = (width + 7) / 8;
+
+  if ((bm->bits = calloc((size_t)bm->stride * ((height + 7) & ~7U) + 1, 1)) == NULL)
+  {
+    fprintf(stderr, "ERROR: pbmtobrf: Unable to allocate memory\n");
+    return (-1);
+  }
+
+  return (0);
+}
+
+
+//
+// 'transpose8()' - Transpose an 8x8 bit matrix, one row per byte.
+//
+
+static uint64_t
+transpose8(uint64_t x)
+{
+  uint64_t t;
+
+  t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+  x ^= t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+  x ^= t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+  x ^= t ^ (t << 28);
+
+  return (x);
+}
+
+
+//
+// 'bitmap_transpose()' - Swap rows and columns.
+//
+
+static int
+bitmap_transpose(bitmap_t *in,
+                 bitmap_t *out)
+{
+  unsigned	bi, bj, k;
+  uint64_t	x;
+
+  if (bitmap_new(out, in->height, in->width))
+    return (-1);
+
+  // Block (bi, bj) of the input, rows 8 bi to 8 bi + 7, byte bj, becomes
+  // block (bj, bi) of the output
+  for (bi = 0; bi < out->stride; bi ++)
+  {
+    for (bj = 0; bj < in->stride; bj ++)
+    {
+      for (x = 0, k = 0; k < 8; k ++)
+	x = (x << 8) | in->bits[(8 * bi + k) * in->stride + bj];
+
+      x = transpose8(x);
+
+      for (k = 0; k < 8; k ++)
+	out->bits[(8 * bj + k) * out->stride + bi] = (unsigned char)(x >> (56 - 8 * k));
+    }
+  }
+
+  return (0);
+}
+
+
+//
+// 'bitmap_flipv()' - Reverse the order of the rows.
+//
+
+static int
+bitmap_flipv(bitmap_t *in,
+             bitmap_t *out)
+{
+  unsigned	y;
+
+  if (bitmap_new(out, in->width, in->height))
+    return (-1);
+
+  for (y = 0; y < in->height; y ++)
+    memcpy(out->bits + (size_t)y * out->stride, in->bits + (size_t)(in->height - 1 - y) * in->stride, in->stride);
+
+  return (0);
+}
+
+
+//
+// 'bitmap_fliph()' - Reverse the order of the dots of each row.
+//
+
+static int
+bitmap_fliph(bitmap_t *in,
+             bitmap_t *out)
+{
+  static unsigned char	rev[256];	// Bit reversed bytes
+  unsigned		i, y, b;
+  unsigned		pad = in->stride * 8 - in->width;
+  unsigned char		*src, *dst;
+
+  if (!rev[1])
+  {
+    for (i = 0; i < 256; i ++)
+      rev[i] = (unsigned char)(((i * 0x0802U & 0x22110U) | (i * 0x8020U & 0x88440U)) * 0x10101U >> 16);
+  }
+
+  if (bitmap_new(out, in->width, in->height))
+    return (-1);
+
+  for (y = 0; y < in->height; y ++)
+  {
+    src = in->bits + (size_t)y * in->stride;
+    dst = out->bits + (size_t)y * out->stride;
+
+    for (b = 0; b < in->stride; b ++)
+      dst[in->stride - 1 - b] = rev[src[b]];
+
+    // The padding of the last byte is now at the start of the row
+    if (pad)
+    {
+      for (b = 0; b < in->stride; b ++)
+	dst[b] = (unsigned char)((dst[b] << pad) | (b + 1 < in->stride ? dst[b + 1] >> (8 - pad) : 0));
+    }
+  }
+
+  return (0);
+}
+
+
+//
+// 'bitmap_negate()' - Swap dots and blanks.
+//
+
+static int
+bitmap_negate(bitmap_t *in,
+              bitmap_t *out)
+{
+  unsigned	y, b;
+  unsigned	pad = in->stride * 8 - in->width;
+  unsigned char	*src, *dst;
+
+  if (bitmap_new(out, in->width, in->height))
+    return (-1);
+
+  for (y = 0; y < in->height; y ++)
+  {
+    src = in->bits + (size_t)y * in->stride;
+    dst = out->bits + (size_t)y * out->stride;
+
+    for (b = 0; b < in->stride; b ++)
+      dst[b] = (unsigned char)~src[b];
+
+    dst[out->stride - 1] &= (unsigned char)(0xff << pad);
+  }
+
+  return (0);
+}
+
+
+//
+// 'bitmap_thicken()' - Add a dot to the right of and below each dot.
+//
+// One dot wide lines, which are hard to feel, become two dots wide.
+//
+
+static int
+bitmap_thicken(bitmap_t *in,
+               bitmap_t *out)
+{
+  unsigned		y, b, k;
+  unsigned		pad = in->stride * 8 - in->width;
+  unsigned char		*src, *dst;
+
+  if (bitmap_new(out, in->width, in->height))
+    return (-1);
+
+  for (y = 0; y < in->height; y ++)
+  {
+    dst = out->bits + (size_t)y * out->stride;
+
+    // This row and the one above, each also shifted right by one dot
+    for (k = 0; k < 2 && k <= y; k ++)
+    {
+      src = in->bits + (size_t)(y - k) * in->stride;
+
+      for (b = 0; b < in->stride; b ++)
+	dst[b] |= (unsigned char)(src[b] | src[b] >> 1 | (b > 0 ? src[b - 1] << 7 : 0));
+    }
+
+    dst[out->stride - 1] &= (unsigned char)(0xff << pad);
+  }
+
+  return (0);
+}
+
+
+//
+// 'bitmap_replace()' - Replace a bitmap with a transformed one.
+//
+
+static int
+bitmap_replace(bitmap_t *bm,
+               int      (*transform)(bitmap_t *, bitmap_t *))
+{
+  bitmap_t	out;
+
+  if ((*transform)(bm, &out))
+    return (-1);
+
+  free(bm->bits);
+  *bm = out;
+
+  return (0);
+}
+
+
+//
+// 'pbm_number()' - Read a number of a PBM header.
+//
+
+static int
+pbm_number(FILE     *fp,
+           unsigned *number)
+{
+  int	ch;
+
+  for (;;)
+  {
+    if ((ch = getc(fp)) == '#')
+    {
+      while ((ch = getc(fp)) != EOF && ch != '\n');
+    }
+    else if (ch != ' ' && ch != '\t' && ch != '\n' && ch != '\r')
+      break;
+  }
+
+  if (ch < '0' || ch > '9')
+    return (-1);
+
+  for (*number = 0; ch >= '0' && ch <= '9'; ch = getc(fp))
+  {
+    if (*number > 100000)
+      return (-1);
+    *number = *number * 10 + (unsigned)(ch - '0');
+  }
+
+  // A single white space character ends the header
+  return (ch == EOF ? -1 : 0);
+}
+
+
+//
+// 'pbm_read()' - Read a raw PBM image.
+//
+
+static int
+pbm_read(FILE     *fp,
+         bitmap_t *bm)
+{
+  unsigned	width, height, y;
+  unsigned	pad;
+
+  if (getc(fp) != 'P' || getc(fp) != '4' || pbm_number(fp, &width) || pbm_number(fp, &height) || !width || !height)
+  {
+    fprintf(stderr, "ERROR: pbmtobrf: Input is not a raw PBM image\n");
+    return (-1);
+  }
+
+  if (bitmap_new(bm, width, height))
+    return (-1);
+
+  if (fread(bm->bits, bm->stride, height, fp) != height)
+  {
+    fprintf(stderr, "ERROR: pbmtobrf: Short PBM image\n");
+    return (-1);
+  }
+
+  // Keep the padding blank
+  if ((pad = bm->stride * 8 - width) != 0)
+  {
+    for (y = 0; y < height; y ++)
+      bm->bits[(size_t)y * bm->stride + bm->stride - 1] &= (unsigned char)(0xff << pad);
+  }
+
+  return (0);
+}
+
+
+//
+// 'dot()' - Get a dot of the page.
+//
+
+static unsigned
+dot(bitmap_t *bm,
+    int      x,
+    int      y)
+{
+  if (x < 0 || y < 0 || (unsigned)x >= bm->width || (unsigned)y >= bm->height)
+    return (0);
+
+  return ((bm->bits[(size_t)y * bm->stride + (unsigned)x / 8] >> (7 - (unsigned)x % 8)) & 1);
+}
+
+
+//
+// 'write_page()' - Write a bitmap placed on a page as braille.
+//
+
+static void
+write_page(bitmap_t *bm,
+           unsigned pwidth,
+           unsigned pheight,
+           int      px,
+           int      py,
+           int      unicode)
+{
+  unsigned	cx, cy, cheight, cell;
+  int		x, y;
+
+  // Crop what goes beyond the page
+  if (px >= 0 && (int)bm->width > (int)pwidth - px)
+    bm->width = (int)pwidth > px ? pwidth - (unsigned)px : 0;
+  if (py >= 0 && (int)bm->height > (int)pheight - py)
+    bm->height = (int)pheight > py ? pheight - (unsigned)py : 0;
+
+  fprintf(stderr, "DEBUG: pbmtobrf: %ux%u dots at %d,%d on %ux%u\n", bm->width, bm->height, px, py, pwidth, pheight);
+
+  // Cells of 2x3 (BRF) or 2x4 (Unicode) dots, dots 1-2-3(-7) on the left
+  cheight = unicode ? 4 : 3;
+
+  for (cy = 0; cy < pheight; cy += cheight)
+  {
+    y = (int)cy - py;
+
+    for (cx = 0; cx < pwidth; cx += 2)
+    {
+      x = (int)cx - px;
+
+      cell = dot(bm, x, y) | dot(bm, x, y + 1) << 1 | dot(bm, x, y + 2) << 2 |
+             dot(bm, x + 1, y) << 3 | dot(bm, x + 1, y + 1) << 4 | dot(bm, x + 1, y + 2) << 5;
+
+      if (unicode)
+      {
+	cell |= dot(bm, x, y + 3) << 6 | dot(bm, x + 1, y + 3) << 7;
+
+	// U+2800 + cell in UTF-8
+	putchar(0xe2);
+	putchar((int)(0xa0 | (cell >> 6)));
+	putchar((int)(0x80 | (cell & 0x3f)));
+      }
+      else
+	putchar(brf[cell]);
+    }
+
+    putchar('\n');
+  }
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+  const char	*filename = NULL;
+  int		negate = 0,
+		rotate = 0,
+		mirror = 0,
+		thicken = 0,
+		unicode = 0;
+  unsigned	pwidth = 0,
+		pheight = 0;
+  int		px = 0,
+		py = 0;
+  int		i;
+  FILE		*fp = stdin;
+  bitmap_t	bm;
+  int		pages, ch;
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "-n"))
+      negate = 1;
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      rotate = atoi(argv[++ i]);
+    else if (!strcmp(argv[i], "-m"))
+      mirror = 1;
+    else if (!strcmp(argv[i], "-t"))
+      thicken = 1;
+    else if (!strcmp(argv[i], "-u"))
+      unicode = 1;
+    else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+    {
+      if (sscanf(argv[++ i], "%ux%u+%d+%d", &pwidth, &pheight, &px, &py) != 4)
+	pwidth = 0;
+    }
+    else if (!filename && argv[i][0] != '-')
+      filename = argv[i];
+    else
+      pwidth = 0, i = argc;
+  }
+
+  if (!pwidth || !pheight || (rotate != 0 && rotate != 90 && rotate != 180 && rotate != 270))
+  {
+    fprintf(stderr, "Usage: pbmtobrf [-n] [-r 0|90|180|270] [-m] [-t] [-u] -p WxH+X+Y [filename]\n");
+    return (1);
+  }
+
+  if (filename && (fp = fopen(filename, "rb")) == NULL)
+  {
+    fprintf(stderr, "ERROR: pbmtobrf: Unable to open %s: %s\n", filename, strerror(errno));
+    return (1);
+  }
+
+  for (pages = 0; ; pages ++)
+  {
+    if (pages > 0)
+    {
+      // Another image?
+      while ((ch = getc(fp)) == ' ' || ch == '\t' || ch == '\n' || ch == '\r');
+      if (ch == EOF)
+	break;
+      ungetc(ch, fp);
+
+      putchar('\f');
+    }
+
+    if (pbm_read(fp, &bm))
+      return (1);
+
+    // Clockwise rotation by 90 is a transpose then a horizontal flip, by 270
+    // a transpose then a vertical flip
+    if ((negate && bitmap_replace(&bm, bitmap_negate)) ||
+	(rotate == 90 && (bitmap_replace(&bm, bitmap_transpose) || bitmap_replace(&bm, bitmap_fliph))) ||
+	(rotate == 180 && (bitmap_replace(&bm, bitmap_flipv) || bitmap_replace(&bm, bitmap_fliph))) ||
+	(rotate == 270 && (bitmap_replace(&bm, bitmap_transpose) || bitmap_replace(&bm, bitmap_flipv))) ||
+	(mirror && bitmap_replace(&bm, bitmap_fliph)) ||
+	(thicken && bitmap_replace(&bm, bitmap_thicken)))
+      return (1);
+
+    write_page(&bm, pwidth, pheight, px, py, unicode);
+
+    free(bm.bits);
+  }
+
+  if (fflush(stdout) || ferror(stdout))
+  {
+    fprintf(stderr, "ERROR: pbmtobrf: Unable to write output: %s\n", strerror(errno));
+    return (1);
+  }
+
+  return (0);
+}
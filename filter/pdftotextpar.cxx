@@ -0,0 +1,319 @@
+//
+// Page-parallel PDF text extractor for the braille filters
+//
+// Copyright (c) 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage: pdftotextpar [-j threads] [filename]
+//
+// Writes the text of a PDF document to stdout like "pdftotext -raw - -":
+// the text of each page in content stream order, followed by a form feed.
+// Pages are extracted concurrently by a pool of threads (one per CPU by
+// default) and written in page order as soon as the previous ones are out,
+// so the formatter downstream starts on the first page right away.  Each
+// thread loads its own poppler document from the same mapping of the file,
+// since a poppler document must not be used by several threads at a time.
+// Threads never get more than a few pages ahead of the output, which bounds
+// the memory used for pages waiting to be written.
+//
+// Standard input is mapped when it is a file; a pipe is first copied to an
+// unlinked temporary file.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poppler-document.h>
+#include <poppler-global.h>
+#include <poppler-page.h>
+
+
+#define AHEAD		4		// Pages per thread allowed ahead of output
+
+
+//
+// Shared state of the extraction...
+//
+
+struct extract_t
+{
+  const char			*data;		// Mapped document
+  int				size;		// Size of document
+  int				num_pages;	// Number of pages
+  int				next_page;	// Next page to extract
+  int				out_page;	// Next page to write
+  int				window;		// Max pages ahead of output
+  bool				failed;		// Did a thread fail?
+  std::vector<std::string>	pages;		// Text of pages not written yet
+  std::vector<bool>		done;		// Pages extracted
+  std::mutex			mutex;		// Mutex for the state
+  std::condition_variable	cond;		// Page done or written
+};
+
+
+//
+// 'error_cb()' - Report poppler errors as debug messages.
+//
+
+static void
+error_cb(const std::string &msg,
+         void              *)
+{
+  fprintf(stderr, "DEBUG: pdftotextpar: %s\n", msg.c_str());
+}
+
+
+//
+// 'load()' - Load the document from the mapping.
+//
+
+static poppler::document *
+load(extract_t *ex)
+{
+  poppler::document *doc = poppler::document::load_from_raw_data(ex->data, ex->size);
+
+  if (doc && doc->is_locked())
+  {
+    delete doc;
+    doc = NULL;
+  }
+
+  return (doc);
+}
+
+
+//
+// 'worker()' - Extract pages until none are left.
+//
+
+static void
+worker(extract_t *ex)
+{
+  std::unique_ptr<poppler::document>	doc(load(ex));
+  int					page;
+  std::string				text;
+
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(ex->mutex);
+
+      // Wait for the output to catch up
+      while (!ex->failed && ex->next_page < ex->num_pages && ex->next_page >= ex->out_page + ex->window)
+	ex->cond.wait(lock);
+
+      if (ex->failed || ex->next_page >= ex->num_pages)
+	return;
+
+      page = ex->next_page ++;
+
+      if (!doc)
+      {
+	ex->failed = true;
+	ex->cond.notify_all();
+	return;
+      }
+    }
+
+    text.clear();
+
+    std::unique_ptr<poppler::page> p(doc->create_page(page));
+    if (p)
+    {
+      poppler::byte_array utf8 = p->text(poppler::rectf(), poppler::page::raw_order_layout).to_utf8();
+      text.assign(utf8.data(), utf8.size());
+    }
+    text += '\f';
+
+    {
+      std::lock_guard<std::mutex> lock(ex->mutex);
+
+      ex->pages[(size_t)page].swap(text);
+      ex->done[(size_t)page] = true;
+      ex->cond.notify_all();
+    }
+  }
+}
+
+
+//
+// 'spool()' - Copy a pipe to an unlinked temporary file.
+//
+
+static int
+spool(int fd)
+{
+  char		filename[1024];
+  char		buffer[65536];
+  const char	*tmpdir = getenv("TMPDIR");
+  ssize_t	bytes;
+  int		tmpfd;
+
+  snprintf(filename, sizeof(filename), "%s/pdftotextpar.XXXXXX", tmpdir ? tmpdir : "/tmp");
+  if ((tmpfd = mkstemp(filename)) < 0)
+    return (-1);
+  unlink(filename);
+
+  while ((bytes = read(fd, buffer, sizeof(buffer))) != 0)
+  {
+    if (bytes < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+	continue;
+      close(tmpfd);
+      return (-1);
+    }
+
+    if (write(tmpfd, buffer, (size_t)bytes) != bytes)
+    {
+      close(tmpfd);
+      return (-1);
+    }
+  }
+
+  return (tmpfd);
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+  const char			*filename = NULL;
+  int				fd = 0;
+  int				i;
+  int				num_threads = 0;
+  struct stat			fileinfo;
+  void				*data;
+  extract_t			ex;
+  std::vector<std::thread>	threads;
+  std::string			text;
+  int				status = 0;
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "-j") && i + 1 < argc)
+      num_threads = atoi(argv[++ i]);
+    else if (!filename && argv[i][0] != '-')
+      filename = argv[i];
+    else
+    {
+      fprintf(stderr, "Usage: pdftotextpar [-j threads] [filename]\n");
+      return (1);
+    }
+  }
+
+  if (filename && (fd = open(filename, O_RDONLY)) < 0)
+  {
+    fprintf(stderr, "ERROR: pdftotextpar: Unable to open %s: %s\n", filename, strerror(errno));
+    return (1);
+  }
+
+  if (fstat(fd, &fileinfo) || !S_ISREG(fileinfo.st_mode))
+  {
+    if ((fd = spool(fd)) < 0 || fstat(fd, &fileinfo))
+    {
+      fprintf(stderr, "ERROR: pdftotextpar: Unable to copy input to a temporary file: %s\n", strerror(errno));
+      return (1);
+    }
+  }
+
+  if (fileinfo.st_size <= 0 || fileinfo.st_size > 0x7fffffff || (data = mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+  {
+    fprintf(stderr, "ERROR: pdftotextpar: Unable to map input\n");
+    return (1);
+  }
+
+  poppler::set_debug_error_function(error_cb, NULL);
+
+  ex.data      = (const char *)data;
+  ex.size      = (int)fileinfo.st_size;
+  ex.next_page = 0;
+  ex.out_page  = 0;
+  ex.failed    = false;
+
+  {
+    std::unique_ptr<poppler::document> doc(load(&ex));
+
+    if (!doc)
+    {
+      fprintf(stderr, "ERROR: pdftotextpar: Unable to open the PDF document\n");
+      return (1);
+    }
+
+    ex.num_pages = doc->pages();
+  }
+
+  if (num_threads <= 0)
+    num_threads = (int)std::thread::hardware_concurrency();
+  if (num_threads > ex.num_pages)
+    num_threads = ex.num_pages;
+  if (num_threads < 1)
+    num_threads = 1;
+
+  ex.window = AHEAD * num_threads;
+  ex.pages.resize((size_t)ex.num_pages);
+  ex.done.resize((size_t)ex.num_pages);
+
+  fprintf(stderr, "DEBUG: pdftotextpar: %d pages, %d threads\n", ex.num_pages, num_threads);
+
+  for (i = 0; i < num_threads; i ++)
+    threads.emplace_back(worker, &ex);
+
+  // Write pages in order as they are done
+  while (ex.out_page < ex.num_pages)
+  {
+    {
+      std::unique_lock<std::mutex> lock(ex.mutex);
+
+      while (!ex.failed && !ex.done[(size_t)ex.out_page])
+	ex.cond.wait(lock);
+
+      if (ex.failed)
+	break;
+
+      text.swap(ex.pages[(size_t)ex.out_page]);
+      ex.pages[(size_t)ex.out_page].clear();
+      ex.pages[(size_t)ex.out_page].shrink_to_fit();
+      ex.out_page ++;
+      ex.cond.notify_all();
+    }
+
+    if (fwrite(text.data(), 1, text.size(), stdout) != text.size() || fflush(stdout))
+    {
+      fprintf(stderr, "ERROR: pdftotextpar: Unable to write output: %s\n", strerror(errno));
+      status = 1;
+
+      std::lock_guard<std::mutex> lock(ex.mutex);
+      ex.failed = true;
+      ex.cond.notify_all();
+      break;
+    }
+  }
+
+  for (auto &thread : threads)
+    thread.join();
+
+  if (ex.failed && !status)
+  {
+    fprintf(stderr, "ERROR: pdftotextpar: Unable to open the PDF document\n");
+    status = 1;
+  }
+
+  return (status);
+}
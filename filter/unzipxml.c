@@ -0,0 +1,628 @@
+//
+// ZIP member extractor for the braille filters
+//
+// Copyright (c) 2022 Chandresh Soni
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage: unzipxml [-t] member [filename]
+//
+// Writes one member of a ZIP archive (OpenDocument or Office Open XML
+// document) to stdout.  The archive is mapped in memory and the member is
+// found through the central directory and inflated straight from the
+// mapping, so only the member is read and memory use does not depend on the
+// document size.  Standard input is mapped as well when it is a file; a pipe
+// is first copied to an unlinked temporary file since the central directory
+// is at the end of the archive.
+//
+// With -t the member is parsed as XML on the fly and only its text is
+// written: paragraphs (text:p, text:h, w:p) end with a blank line, tabs,
+// spaces (text:s with its text:c count) and line breaks elements are turned
+// into the corresponding characters and entities are decoded.  w:tab is
+// only a tab within a run (w:r), elsewhere it defines a tab stop.  Text is taken from within
+// office:body (OpenDocument) or w:t elements (Office Open XML).
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+
+//
+// XML text extraction state...
+//
+
+typedef enum
+{
+  XML_TEXT,				// Character data
+  XML_TAG,				// Tag name
+  XML_ATTRS,				// Attributes of a tag
+  XML_ATTRVALUE,			// Quoted attribute value
+  XML_ENTITY,				// Entity reference
+  XML_SPECIAL,				// <? ... ?> or <!-- ... --> or <!...>
+  XML_CDATA				// <![CDATA[ ... ]]>
+} xml_state_t;
+
+typedef struct
+{
+  xml_state_t	state;			// Parser state
+  char		name[64];		// Tag name
+  size_t	namelen;		// Length of tag name
+  int		closing,		// Closing tag?
+		empty;			// Empty element tag?
+  char		quote;			// Quote of attribute value
+  char		attr[16];		// Attribute name
+  size_t	attrlen;		// Length of attribute name
+  unsigned	count;			// Value of text:c attribute
+  char		entity[16];		// Entity name
+  size_t	entitylen;		// Length of entity name
+  char		special[3];		// Last characters of special section
+  int		body,			// Depth in office:body
+		wr,			// Depth in w:r
+		wt;			// Depth in w:t
+} xml_t;
+
+
+//
+// 'out()' - Write data to stdout.
+//
+
+static int
+out(const void *data,
+    size_t len)
+{
+  if (len > 0 && fwrite(data, 1, len, stdout) != len)
+  {
+    fprintf(stderr, "ERROR: unzipxml: Unable to write output: %s\n", strerror(errno));
+    return (-1);
+  }
+
+  return (0);
+}
+
+
+//
+// 'xml_intext()' - Is character data currently wanted?
+//
+
+static int
+xml_intext(xml_t *xml)
+{
+  return (xml->body > 0 || xml->wt > 0);
+}
+
+
+//
+// 'xml_entity()' - Write a decoded entity.
+//
+
+static void
+xml_entity(xml_t *xml)
+{
+  unsigned long	ch = 0;
+  char		utf8[4];
+  const char	*e = xml->entity;
+
+  if (!xml_intext(xml))
+    return;
+
+  if (!strcmp(e, "amp"))
+    ch = '&';
+  else if (!strcmp(e, "lt"))
+    ch = '<';
+  else if (!strcmp(e, "gt"))
+    ch = '>';
+  else if (!strcmp(e, "quot"))
+    ch = '\"';
+  else if (!strcmp(e, "apos"))
+    ch = '\'';
+  else if (e[0] == '#' && (e[1] == 'x' || e[1] == 'X'))
+    ch = strtoul(e + 2, NULL, 16);
+  else if (e[0] == '#')
+    ch = strtoul(e + 1, NULL, 10);
+
+  if (ch == 0 || ch > 0x10ffff)
+    return;
+
+  if (ch < 0x80)
+  {
+    putchar((int)ch);
+  }
+  else if (ch < 0x800)
+  {
+    utf8[0] = (char)(0xc0 | (ch >> 6));
+    utf8[1] = (char)(0x80 | (ch & 0x3f));
+    out(utf8, 2);
+  }
+  else if (ch < 0x10000)
+  {
+    utf8[0] = (char)(0xe0 | (ch >> 12));
+    utf8[1] = (char)(0x80 | ((ch >> 6) & 0x3f));
+    utf8[2] = (char)(0x80 | (ch & 0x3f));
+    out(utf8, 3);
+  }
+  else
+  {
+    utf8[0] = (char)(0xf0 | (ch >> 18));
+    utf8[1] = (char)(0x80 | ((ch >> 12) & 0x3f));
+    utf8[2] = (char)(0x80 | ((ch >> 6) & 0x3f));
+    utf8[3] = (char)(0x80 | (ch & 0x3f));
+    out(utf8, 4);
+  }
+}
+
+
+//
+// 'xml_tag()' - Handle the end of a start, end or empty element tag.
+//
+
+static void
+xml_tag(xml_t *xml)
+{
+  const char	*name = xml->name;
+  int		start = !xml->closing,
+		end = xml->closing || xml->empty;
+
+  if (!strcmp(name, "office:body"))
+  {
+    if (start)
+      xml->body ++;
+    if (end && xml->body > 0)
+      xml->body --;
+    return;
+  }
+
+  if (!strcmp(name, "w:t"))
+  {
+    if (start)
+      xml->wt ++;
+    if (end && xml->wt > 0)
+      xml->wt --;
+    return;
+  }
+
+  if (!strcmp(name, "w:r"))
+  {
+    if (start)
+      xml->wr ++;
+    if (end && xml->wr > 0)
+      xml->wr --;
+    return;
+  }
+
+  if (!xml->body && strncmp(name, "w:", 2))
+    return;
+
+  if (end && (!strcmp(name, "text:p") || !strcmp(name, "text:h") || !strcmp(name, "w:p")))
+    out("\n\n", 2);
+  else if (start && (!strcmp(name, "text:tab") || (!strcmp(name, "w:tab") && xml->wr > 0)))
+    putchar('\t');
+  else if (start && !strcmp(name, "text:s"))
+  {
+    unsigned i;
+
+    for (i = xml->count ? xml->count : 1; i > 0; i --)
+      putchar(' ');
+  }
+  else if (start && (!strcmp(name, "text:line-break") || !strcmp(name, "w:br") || !strcmp(name, "w:cr")))
+    putchar('\n');
+}
+
+
+//
+// 'xml_data()' - Parse XML data and write its text.
+//
+
+static void
+xml_data(xml_t *xml,
+	 const unsigned char *data,
+	 size_t len)
+{
+  const unsigned char	*ptr, *end, *start;
+  unsigned char		c;
+
+  for (ptr = data, end = data + len; ptr < end; ptr ++)
+  {
+    c = *ptr;
+
+    switch (xml->state)
+    {
+      case XML_TEXT :
+          // Copy runs of plain characters at once
+	  for (start = ptr; ptr < end && *ptr != '<' && *ptr != '&'; ptr ++);
+	  if (xml_intext(xml))
+	    out(start, (size_t)(ptr - start));
+	  if (ptr >= end)
+	    return;
+
+	  if (*ptr == '<')
+	  {
+	    xml->state   = XML_TAG;
+	    xml->namelen = 0;
+	    xml->closing = 0;
+	    xml->empty   = 0;
+	    xml->attrlen = 0;
+	    xml->count   = 0;
+	  }
+	  else
+	  {
+	    xml->state     = XML_ENTITY;
+	    xml->entitylen = 0;
+	  }
+	  break;
+
+      case XML_ENTITY :
+	  if (c == ';')
+	  {
+	    xml->entity[xml->entitylen] = '\0';
+	    xml_entity(xml);
+	    xml->state = XML_TEXT;
+	  }
+	  else if (xml->entitylen < sizeof(xml->entity) - 1)
+	    xml->entity[xml->entitylen ++] = (char)c;
+	  break;
+
+      case XML_TAG :
+	  if (xml->namelen == 0 && !xml->closing && c == '/')
+	  {
+	    xml->closing = 1;
+	  }
+	  else if (xml->namelen == 0 && !xml->closing && (c == '?' || c == '!'))
+	  {
+	    xml->state = XML_SPECIAL;
+	    memset(xml->special, 0, sizeof(xml->special));
+	    xml->name[0] = (char)c;
+	    xml->namelen = 1;
+	  }
+	  else if (c == '>' || c == '/' || c == ' ' || c == '\t' || c == '\n' || c == '\r')
+	  {
+	    xml->name[xml->namelen] = '\0';
+	    if (c == '>')
+	    {
+	      xml_tag(xml);
+	      xml->state = XML_TEXT;
+	    }
+	    else
+	    {
+	      if (c == '/')
+		xml->empty = 1;
+	      xml->state = XML_ATTRS;
+	    }
+	  }
+	  else if (xml->namelen < sizeof(xml->name) - 1)
+	    xml->name[xml->namelen ++] = (char)c;
+	  break;
+
+      case XML_ATTRS :
+	  if (c == '\"' || c == '\'')
+	  {
+	    xml->attr[xml->attrlen] = '\0';
+	    xml->quote = (char)c;
+	    xml->state = XML_ATTRVALUE;
+	  }
+	  else if (c == '/')
+	    xml->empty = 1;
+	  else if (c == '>')
+	  {
+	    xml_tag(xml);
+	    xml->state = XML_TEXT;
+	  }
+	  else if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+	  {
+	    xml->empty = 0;
+	    if (c != '=' && xml->attrlen < sizeof(xml->attr) - 1)
+	      xml->attr[xml->attrlen ++] = (char)c;
+	  }
+	  break;
+
+      case XML_ATTRVALUE :
+	  if (c == (unsigned char)xml->quote)
+	  {
+	    xml->state   = XML_ATTRS;
+	    xml->attrlen = 0;
+	  }
+	  else if (c >= '0' && c <= '9' && !strcmp(xml->attr, "text:c") && xml->count < 10000)
+	    xml->count = xml->count * 10 + (unsigned)(c - '0');
+	  break;
+
+      case XML_SPECIAL :
+	  if (xml->namelen < sizeof(xml->name) - 1)
+	  {
+	    xml->name[xml->namelen ++] = (char)c;
+	    xml->name[xml->namelen]    = '\0';
+
+	    if (!strcmp(xml->name, "![CDATA["))
+	    {
+	      xml->state = XML_CDATA;
+	      memset(xml->special, 0, sizeof(xml->special));
+	      break;
+	    }
+	  }
+
+	  xml->special[0] = xml->special[1];
+	  xml->special[1] = xml->special[2];
+	  xml->special[2] = (char)c;
+
+	  if (c != '>')
+	    break;
+
+	  if (xml->name[0] == '?')
+	  {
+	    // Processing instruction, ends with ?>
+	    if (xml->special[1] == '?')
+	      xml->state = XML_TEXT;
+	  }
+	  else if (!strncmp(xml->name, "!--", 3))
+	  {
+	    // Comment, ends with -->, "<!---->" is the shortest one
+	    if (xml->namelen >= 6 && xml->special[0] == '-' && xml->special[1] == '-')
+	      xml->state = XML_TEXT;
+	  }
+	  else
+	    xml->state = XML_TEXT;
+	  break;
+
+      case XML_CDATA :
+	  xml->special[0] = xml->special[1];
+	  xml->special[1] = xml->special[2];
+	  xml->special[2] = (char)c;
+
+	  if (c == '>' && xml->special[0] == ']' && xml->special[1] == ']')
+	    xml->state = XML_TEXT;
+	  else if (c != ']' && xml_intext(xml))
+	  {
+	    // Write held back ]s which were not the end of the section
+	    if (xml->special[1] == ']')
+	      out(xml->special[0] == ']' ? "]]" : "]", xml->special[0] == ']' ? 2 : 1);
+	    putchar(c);
+	  }
+	  break;
+    }
+  }
+}
+
+
+//
+// 'get16()' and 'get32()' - Get little-endian values.
+//
+
+static unsigned
+get16(const unsigned char *p)
+{
+  return ((unsigned)p[0] | ((unsigned)p[1] << 8));
+}
+
+static unsigned long
+get32(const unsigned char *p)
+{
+  return ((unsigned long)p[0] | ((unsigned long)p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24));
+}
+
+
+//
+// 'spool()' - Copy a pipe to an unlinked temporary file.
+//
+
+static int
+spool(int fd)
+{
+  char		filename[1024];
+  char		buffer[65536];
+  const char	*tmpdir = getenv("TMPDIR");
+  ssize_t	bytes;
+  int		tmpfd;
+
+  snprintf(filename, sizeof(filename), "%s/unzipxml.XXXXXX", tmpdir ? tmpdir : "/tmp");
+  if ((tmpfd = mkstemp(filename)) < 0)
+    return (-1);
+  unlink(filename);
+
+  while ((bytes = read(fd, buffer, sizeof(buffer))) != 0)
+  {
+    if (bytes < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+	continue;
+      close(tmpfd);
+      return (-1);
+    }
+
+    if (write(tmpfd, buffer, (size_t)bytes) != bytes)
+    {
+      close(tmpfd);
+      return (-1);
+    }
+  }
+
+  return (tmpfd);
+}
+
+
+int
+main(int argc,
+     char *argv[])
+{
+  const char		*member = NULL;
+  const char		*filename = NULL;
+  int			text = 0;
+  int			fd = 0;
+  int			i;
+  struct stat		fileinfo;
+  const unsigned char	*zip, *eocd, *cd, *cdend, *local, *data;
+  size_t		size;
+  unsigned long		compsize, uncompsize, crc, check, offset;
+  unsigned		method, namelen, extralen, commentlen;
+  size_t		memberlen;
+  xml_t			xml;
+  z_stream		stream;
+  unsigned char		buffer[65536];
+  int			status;
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "-t"))
+      text = 1;
+    else if (!member && argv[i][0] != '-')
+      member = argv[i];
+    else if (!filename && argv[i][0] != '-')
+      filename = argv[i];
+    else
+      member = NULL, i = argc;
+  }
+
+  if (!member)
+  {
+    fprintf(stderr, "Usage: unzipxml [-t] member [filename]\n");
+    return (1);
+  }
+
+  if (filename && (fd = open(filename, O_RDONLY)) < 0)
+  {
+    fprintf(stderr, "ERROR: unzipxml: Unable to open %s: %s\n", filename, strerror(errno));
+    return (1);
+  }
+
+  if (fstat(fd, &fileinfo) || !S_ISREG(fileinfo.st_mode))
+  {
+    if ((fd = spool(fd)) < 0 || fstat(fd, &fileinfo))
+    {
+      fprintf(stderr, "ERROR: unzipxml: Unable to copy input to a temporary file: %s\n", strerror(errno));
+      return (1);
+    }
+  }
+
+  if ((size = (size_t)fileinfo.st_size) < 22 || (zip = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+  {
+    fprintf(stderr, "ERROR: unzipxml: Input is not a ZIP archive\n");
+    return (1);
+  }
+
+  // Find the end of central directory record, it is followed by a comment
+  // of up to 65535 bytes
+  for (eocd = zip + size - 22; eocd >= zip && (size - (size_t)(eocd - zip)) <= 22 + 65535; eocd --)
+  {
+    if (get32(eocd) == 0x06054b50)
+      break;
+  }
+
+  if (eocd < zip || get32(eocd) != 0x06054b50 || get32(eocd + 16) == 0xffffffff || get32(eocd + 16) + get32(eocd + 12) > (size_t)(eocd - zip))
+  {
+    fprintf(stderr, "ERROR: unzipxml: Input is not a ZIP archive or is not supported\n");
+    return (1);
+  }
+
+  // Look up the member in the central directory
+  memberlen = strlen(member);
+  cd        = zip + get32(eocd + 16);
+  cdend     = cd + get32(eocd + 12);
+  local     = NULL;
+
+  while (cd + 46 <= cdend && get32(cd) == 0x02014b50)
+  {
+    namelen    = get16(cd + 28);
+    extralen   = get16(cd + 30);
+    commentlen = get16(cd + 32);
+
+    if (cd + 46 + namelen > cdend)
+      break;
+
+    if (namelen == memberlen && !memcmp(cd + 46, member, memberlen))
+    {
+      method     = get16(cd + 10);
+      crc        = get32(cd + 16);
+      compsize   = get32(cd + 20);
+      uncompsize = get32(cd + 24);
+      offset     = get32(cd + 42);
+
+      if (offset + 30 <= size && get32(zip + offset) == 0x04034b50)
+	local = zip + offset;
+      break;
+    }
+
+    cd += 46 + namelen + extralen + commentlen;
+  }
+
+  if (!local)
+  {
+    fprintf(stderr, "ERROR: unzipxml: %s not found in archive\n", member);
+    return (1);
+  }
+
+  data = local + 30 + get16(local + 26) + get16(local + 28);
+
+  if (data > zip + size || compsize > (size_t)(zip + size - data) || (method != 0 && method != 8))
+  {
+    fprintf(stderr, "ERROR: unzipxml: Unsupported or damaged archive member %s\n", member);
+    return (1);
+  }
+
+  memset(&xml, 0, sizeof(xml));
+
+  if (method == 0)
+  {
+    // Stored
+    if (text)
+      xml_data(&xml, data, compsize);
+    else if (out(data, compsize))
+      return (1);
+
+    check  = crc32(crc32(0, NULL, 0), data, (uInt)compsize);
+    status = compsize == uncompsize ? Z_STREAM_END : Z_DATA_ERROR;
+  }
+  else
+  {
+    // Deflated, inflate from the mapping in output buffer sized steps
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+    {
+      fprintf(stderr, "ERROR: unzipxml: Unable to initialize decompression\n");
+      return (1);
+    }
+
+    stream.next_in  = (Bytef *)data;
+    stream.avail_in = (uInt)compsize;
+    check           = crc32(0, NULL, 0);
+
+    do
+    {
+      stream.next_out  = buffer;
+      stream.avail_out = sizeof(buffer);
+
+      status = inflate(&stream, Z_NO_FLUSH);
+
+      if (status != Z_OK && status != Z_STREAM_END)
+	break;
+
+      check = crc32(check, buffer, (uInt)(sizeof(buffer) - stream.avail_out));
+
+      if (text)
+	xml_data(&xml, buffer, sizeof(buffer) - stream.avail_out);
+      else if (out(buffer, sizeof(buffer) - stream.avail_out))
+	return (1);
+    }
+    while (status == Z_OK);
+
+    if (status == Z_STREAM_END && stream.total_out != uncompsize)
+      status = Z_DATA_ERROR;
+
+    inflateEnd(&stream);
+  }
+
+  if (fflush(stdout))
+    return (1);
+
+  if (status != Z_STREAM_END || check != crc)
+  {
+    fprintf(stderr, "ERROR: unzipxml: %s is damaged\n", member);
+    return (1);
+  }
+
+  return (0);
+}